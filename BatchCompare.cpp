@@ -0,0 +1,142 @@
+#include "BatchCompare.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include "ConcurrentQueue.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+// The images of one pair, read by the loader thread
+struct LoadedPair {
+  size_t index;
+  unique_ptr<BitMap> bmp1;
+  unique_ptr<BitMap> bmp2;
+};
+
+// Returns the reason bmp could not be read from file, or an empty string
+string load_error(BitMap& bmp, const string& file) {
+  if (bmp.check_error() == BMP_OK) {
+    return "";
+  }
+  return file + ": " + bmp.error_description();
+}
+
+// Closes a queue when it goes out of scope, so that a producer blocked on
+// it gives up even if the consumer stops early
+template <typename T>
+struct QueueCloser {
+  ConcurrentQueue<T>& queue;
+  ~QueueCloser() { queue.close(); }
+};
+
+}  // namespace
+
+bool pairs_in_directories(const string& dir1,
+                          const string& dir2,
+                          vector<ImagePair>& pairs,
+                          string& error) {
+  error_code code;
+  vector<string> names;
+  for (fs::directory_iterator it(dir1, code), end; !code && it != end;
+       it.increment(code)) {
+    const fs::path& path = it->path();
+    if (path.extension() == ".bmp" && !it->is_directory(code)) {
+      names.push_back(path.filename().string());
+    }
+  }
+  if (code) {
+    error = dir1 + ": " + code.message();
+    return false;
+  }
+
+  sort(names.begin(), names.end());
+  for (const string& name : names) {
+    pairs.push_back(ImagePair{(fs::path(dir1) / name).string(),
+                              (fs::path(dir2) / name).string()});
+  }
+  return true;
+}
+
+bool pairs_in_manifest(const string& manifest,
+                       vector<ImagePair>& pairs,
+                       string& error) {
+  ifstream in(manifest);
+  if (!in) {
+    error = manifest + ": cannot be opened";
+    return false;
+  }
+
+  const fs::path base = fs::path(manifest).parent_path();
+  string line;
+  for (size_t number = 1; getline(in, line); ++number) {
+    istringstream fields(line);
+    string file1, file2, extra;
+    if (!(fields >> file1) || file1[0] == '#') {
+      continue;
+    }
+    if (!(fields >> file2) || fields >> extra) {
+      error = manifest + ":" + to_string(number) +
+              ": expected two paths, found \"" + line + "\"";
+      return false;
+    }
+    pairs.push_back(ImagePair{(base / file1).string(), (base / file2).string()});
+  }
+  return true;
+}
+
+void compare_batch(const vector<ImagePair>& pairs,
+                   ThreadPool& pool,
+                   const BatchSettings& settings,
+                   const function<void(const PairResult&)>& report) {
+  ConcurrentQueue<LoadedPair> loaded(max<size_t>(settings.prefetch, 1));
+
+  // The images are read whole rather than mapped, so that the loader
+  // thread does the reading instead of page faults during the comparison
+  jthread loader([&] {
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      LoadedPair next{
+          i,
+          make_unique<BitMap>(pairs[i].file1, BitMap::LoadMode::kRead),
+          make_unique<BitMap>(pairs[i].file2, BitMap::LoadMode::kRead)};
+      if (!loaded.add(std::move(next))) {
+        return;
+      }
+    }
+    loaded.close();
+  });
+  QueueCloser<LoadedPair> closer{loaded};
+
+  while (optional<LoadedPair> next = loaded.wait_remove()) {
+    BitMap& bmp1 = *next->bmp1;
+    BitMap& bmp2 = *next->bmp2;
+    const ImagePair& pair = pairs[next->index];
+
+    PairResult result{&pair};
+    result.error = load_error(bmp1, pair.file1);
+    if (result.error.empty()) {
+      result.error = load_error(bmp2, pair.file2);
+    }
+    if (result.error.empty()) {
+      result.width1 = bmp1.width();
+      result.height1 = bmp1.height();
+      result.width2 = bmp2.width();
+      result.height2 = bmp2.height();
+      result.totals = compare_images(bmp1, bmp2, pool);
+      if (settings.measure) {
+        result.quality =
+            measure_quality(bmp1, bmp2, pool, settings.ssim_window);
+      }
+    }
+    // Free the images before reporting, so that at most prefetch loaded
+    // pairs are held while the loader reads the next one
+    next.reset();
+    report(result);
+  }
+}
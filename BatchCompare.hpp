@@ -0,0 +1,90 @@
+#ifndef BATCHCOMPARE_HPP_
+#define BATCHCOMPARE_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "BmpCompare.hpp"
+#include "ImageQuality.hpp"
+#include "ThreadPool.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Compares many pairs of images in one process, for golden image checks.
+//
+// The pairs come from two directories or from a manifest file. They are
+// compared one after another, each on every worker of a ThreadPool, while
+// a loader thread reads the images of the next pairs, so the time spent
+// reading and decoding files overlaps with the time spent comparing.
+///////////////////////////////////////////////////////////////////////////////
+
+// Two image files to compare
+struct ImagePair {
+  std::string file1;
+  std::string file2;
+};
+
+// What comparing one pair found
+struct PairResult {
+  const ImagePair* pair;
+  std::string error;  // why an image could not be read, empty if both were
+  UINT width1 = 0, height1 = 0, width2 = 0, height2 = 0;
+  CompareTotals totals;  // only valid if error is empty
+  QualityMetrics quality;  // only valid if measured and error is empty
+};
+
+// How compare_batch() goes through the pairs
+struct BatchSettings {
+  size_t prefetch = 2;     // loaded pairs that may wait, at least 1
+  bool measure = false;    // whether to measure_quality() each pair too
+  UINT ssim_window = kDefaultSsimWindow;
+};
+
+// Pairs every .bmp file in dir1 with the file of the same name in dir2,
+// sorted by name. Files only in dir2 are ignored; files only in dir1 are
+// still paired, so that reading the missing one reports them.
+//
+// Arguments:
+// - dir1, dir2: the directories
+// - pairs: where to append the pairs
+// - error: set to the reason if the function fails
+//
+// Returns:
+// - true if dir1 could be listed
+// - false otherwise
+bool pairs_in_directories(const std::string& dir1,
+                          const std::string& dir2,
+                          std::vector<ImagePair>& pairs,
+                          std::string& error);
+
+// Reads pairs from a manifest file with one pair per line: two paths
+// separated by whitespace, relative to the manifest's directory unless
+// absolute. Blank lines and lines starting with # are skipped.
+//
+// Arguments:
+// - manifest: the path of the manifest file
+// - pairs: where to append the pairs
+// - error: set to the reason if the function fails
+//
+// Returns:
+// - true if the manifest could be read and every line holds a pair
+// - false otherwise
+bool pairs_in_manifest(const std::string& manifest,
+                       std::vector<ImagePair>& pairs,
+                       std::string& error);
+
+// Compares every pair with compare_images(), and measure_quality() if
+// asked to, in order, while a loader thread reads up to settings.prefetch
+// pairs ahead, and calls report with the result of each pair on the
+// calling thread, in order.
+//
+// Arguments:
+// - pairs: the pairs to compare
+// - pool: the workers each comparison is split between
+// - settings: how far to read ahead and what to measure
+// - report: called once per pair
+void compare_batch(const std::vector<ImagePair>& pairs,
+                   ThreadPool& pool,
+                   const BatchSettings& settings,
+                   const std::function<void(const PairResult&)>& report);
+
+#endif  // BATCHCOMPARE_HPP_
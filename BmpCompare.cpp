@@ -0,0 +1,308 @@
+#include "BmpCompare.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <optional>
+#include <vector>
+#include "PixelKernels.hpp"
+
+using namespace std;
+
+namespace {
+
+// One worker's totals, on a cache line of its own so that workers adding
+// to their totals do not slow each other down
+struct alignas(64) WorkerTotals {
+  CompareTotals totals;
+};
+
+// Compares the pixels of row from x = first on with black
+void compare_to_black(const RowSpan& row, UINT first, CompareTotals& totals) {
+  for (UINT x = first; x < row.width; ++x) {
+    const UCHAR* p = row.pixel(x);
+    int sum = p[RowSpan::kRed] + p[RowSpan::kGreen] + p[RowSpan::kBlue];
+    totals.diff += sum;
+    (sum == 0 ? totals.correct_pixels : totals.incorrect_pixels)++;
+  }
+}
+
+// Adds the comparison of row y of bmp1 with the same row of bmp2 to totals
+void compare_row_pair(const RowSpan& row1,
+                      BitMap& bmp2,
+                      UINT y,
+                      UINT shared_width,
+                      CompareTotals& totals) {
+  UINT compared = 0;
+  if (y < bmp2.height()) {
+    RowComparison result = compare_rows(row1, bmp2.row(y), shared_width);
+    totals.diff += result.diff;
+    totals.correct_pixels += result.matching;
+    totals.incorrect_pixels += shared_width - result.matching;
+    compared = shared_width;
+  }
+  compare_to_black(row1, compared, totals);
+}
+
+// Returns the number of pixels of row y of bmp1 that differ from bmp2
+long incorrect_in_row(BitMap& bmp1, BitMap& bmp2, UINT y, UINT shared_width) {
+  RowSpan row1 = bmp1.row(y);
+  if (y < bmp2.height() && shared_width == row1.width) {
+    RowSpan row2 = bmp2.row(y);
+    if (row1.bytes_per_pixel == row2.bytes_per_pixel &&
+        memcmp(row1.data, row2.data, row1.size_bytes()) == 0) {
+      return 0;
+    }
+  }
+  CompareTotals totals;
+  compare_row_pair(row1, bmp2, y, shared_width, totals);
+  return totals.incorrect_pixels;
+}
+
+// The differing pixels of one kDiffCellSize square cell of the image
+struct DiffCell {
+  UINT min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+  long pixels = 0;
+};
+
+// The cells of an image, row by row
+struct DiffCells {
+  DiffCells(UINT width, UINT height)
+      : columns((width + kDiffCellSize - 1) / kDiffCellSize),
+        rows((height + kDiffCellSize - 1) / kDiffCellSize),
+        cells(columns * rows) {}
+
+  DiffCell& at(UINT x, UINT y) {
+    return cells[(y / kDiffCellSize) * columns + x / kDiffCellSize];
+  }
+
+  size_t columns;
+  size_t rows;
+  vector<DiffCell> cells;
+};
+
+// Draws row y of the differences into diff->image, and adds the differing
+// pixels of the row to their cells
+void record_row_diff(const RowSpan& row1,
+                     BitMap& bmp2,
+                     UINT y,
+                     UINT shared_width,
+                     DiffOutput& diff,
+                     DiffCells& cells) {
+  const bool inside = y < bmp2.height();
+  const RowSpan row2 = inside ? bmp2.row(y) : row1;
+  const RowSpan out = diff.image != nullptr ? diff.image->row(y) : RowSpan{};
+  const bool mask = diff.style == DiffStyle::kMask;
+  for (UINT x = 0; x < row1.width; ++x) {
+    static const UCHAR kBlack[4] = {0, 0, 0, 0};
+    const UCHAR* p1 = row1.pixel(x);
+    const UCHAR* p2 = inside && x < shared_width ? row2.pixel(x) : kBlack;
+    int red = abs(p1[RowSpan::kRed] - p2[RowSpan::kRed]);
+    int green = abs(p1[RowSpan::kGreen] - p2[RowSpan::kGreen]);
+    int blue = abs(p1[RowSpan::kBlue] - p2[RowSpan::kBlue]);
+    const bool differs = (red | green | blue) != 0;
+
+    if (out.data != nullptr) {
+      UCHAR* o = out.pixel(x);
+      if (mask) {
+        red = differs ? 255 : 0;
+        green = differs ? 0 : 96;
+        blue = 0;
+      } else {
+        red = min(255, red * diff.gain);
+        green = min(255, green * diff.gain);
+        blue = min(255, blue * diff.gain);
+      }
+      o[RowSpan::kRed] = red;
+      o[RowSpan::kGreen] = green;
+      o[RowSpan::kBlue] = blue;
+    }
+    if (differs) {
+      DiffCell& cell = cells.at(x, y);
+      if (cell.pixels++ == 0) {
+        cell.min_x = cell.max_x = x;
+        cell.min_y = cell.max_y = y;
+      } else {
+        cell.min_x = min(cell.min_x, x);
+        cell.max_x = max(cell.max_x, x);
+        cell.max_y = y;  // rows are visited top to bottom
+      }
+    }
+  }
+}
+
+// Fills row y of diff->image as for a row with no differing pixel
+void fill_matching_row(DiffOutput& diff, UINT y, UINT width) {
+  RowSpan out = diff.image->row(y);
+  if (diff.style == DiffStyle::kAbsolute) {
+    memset(out.data, 0, out.size_bytes());
+    return;
+  }
+  for (UINT x = 0; x < width; ++x) {
+    UCHAR* o = out.pixel(x);
+    o[RowSpan::kRed] = 0;
+    o[RowSpan::kGreen] = 96;
+    o[RowSpan::kBlue] = 0;
+  }
+}
+
+// Returns the root of cell in the union-find forest parents
+size_t find_root(vector<size_t>& parents, size_t cell) {
+  while (parents[cell] != cell) {
+    parents[cell] = parents[parents[cell]];  // halve the path
+    cell = parents[cell];
+  }
+  return cell;
+}
+
+// Groups the cells with differing pixels whose cells touch, and returns
+// the box around each group, top to bottom and then left to right
+vector<DiffBox> box_cells(const DiffCells& grid) {
+  const vector<DiffCell>& cells = grid.cells;
+  vector<size_t> parents(cells.size());
+  iota(parents.begin(), parents.end(), 0);
+  for (size_t row = 0; row < grid.rows; ++row) {
+    for (size_t column = 0; column < grid.columns; ++column) {
+      const size_t cell = row * grid.columns + column;
+      if (cells[cell].pixels == 0) {
+        continue;
+      }
+      // Join the already visited neighbours: left, and the three above
+      const int neighbours[4][2] = {{-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+      for (const auto& [dx, dy] : neighbours) {
+        const long nx = static_cast<long>(column) + dx;
+        const long ny = static_cast<long>(row) + dy;
+        if (nx < 0 || ny < 0 || nx >= static_cast<long>(grid.columns)) {
+          continue;
+        }
+        const size_t other = ny * grid.columns + nx;
+        if (cells[other].pixels > 0) {
+          parents[find_root(parents, other)] = find_root(parents, cell);
+        }
+      }
+    }
+  }
+
+  // One box per root, built up from its cells' extents
+  vector<DiffCell> groups(cells.size());
+  for (size_t cell = 0; cell < cells.size(); ++cell) {
+    if (cells[cell].pixels == 0) {
+      continue;
+    }
+    DiffCell& group = groups[find_root(parents, cell)];
+    if (group.pixels == 0) {
+      group = cells[cell];
+    } else {
+      group.min_x = min(group.min_x, cells[cell].min_x);
+      group.min_y = min(group.min_y, cells[cell].min_y);
+      group.max_x = max(group.max_x, cells[cell].max_x);
+      group.max_y = max(group.max_y, cells[cell].max_y);
+      group.pixels += cells[cell].pixels;
+    }
+  }
+  vector<DiffBox> boxes;
+  for (const DiffCell& group : groups) {
+    if (group.pixels > 0) {
+      boxes.push_back(DiffBox{group.min_x, group.min_y,
+                              group.max_x - group.min_x + 1,
+                              group.max_y - group.min_y + 1, group.pixels});
+    }
+  }
+  sort(boxes.begin(), boxes.end(), [](const DiffBox& a, const DiffBox& b) {
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+  });
+  return boxes;
+}
+
+}  // namespace
+
+CompareTotals compare_images(BitMap& bmp1,
+                             BitMap& bmp2,
+                             ThreadPool& pool,
+                             DiffOutput* diff) {
+  const UINT width = bmp1.width();
+  const UINT height = bmp1.height();
+  const UINT shared_width = min(width, bmp2.width());
+
+  // With a diff, chunks are whole rows of cells, so that each cell is
+  // only ever updated by one worker
+  size_t grain = 0;
+  optional<DiffCells> cells;
+  if (diff != nullptr) {
+    cells.emplace(width, height);
+    grain = height / (4 * static_cast<size_t>(pool.size()));
+    grain = max<size_t>(1, (grain + kDiffCellSize - 1) / kDiffCellSize) *
+            kDiffCellSize;
+  }
+
+  vector<WorkerTotals> partials(pool.size());
+  pool.parallel_for(0, height, grain, [&](size_t start_y, size_t end_y) {
+    CompareTotals section;
+    for (UINT y = start_y; y < end_y; ++y) {
+      RowSpan row1 = bmp1.row(y);
+      const long incorrect_before = section.incorrect_pixels;
+      compare_row_pair(row1, bmp2, y, shared_width, section);
+      if (diff == nullptr) {
+        continue;
+      }
+      if (section.incorrect_pixels > incorrect_before) {
+        record_row_diff(row1, bmp2, y, shared_width, *diff, *cells);
+      } else if (diff->image != nullptr) {
+        fill_matching_row(*diff, y, width);
+      }
+    }
+    CompareTotals& totals = partials[ThreadPool::current_worker()].totals;
+    totals.diff += section.diff;
+    totals.correct_pixels += section.correct_pixels;
+    totals.incorrect_pixels += section.incorrect_pixels;
+  });
+
+  CompareTotals totals;
+  for (const WorkerTotals& partial : partials) {
+    totals.diff += partial.totals.diff;
+    totals.correct_pixels += partial.totals.correct_pixels;
+    totals.incorrect_pixels += partial.totals.incorrect_pixels;
+  }
+  if (diff != nullptr) {
+    diff->boxes = box_cells(*cells);
+  }
+  return totals;
+}
+
+bool images_within_tolerance(BitMap& bmp1,
+                             BitMap& bmp2,
+                             long max_incorrect,
+                             ThreadPool& pool) {
+  const UINT width = bmp1.width();
+  const UINT shared_width = min(width, bmp2.width());
+
+  // incorrect only goes up and at_most, which counts every unchecked pixel
+  // as incorrect, only goes down, so each gives the answer on its own once
+  // it crosses max_incorrect. Rows are handed out in small chunks so that
+  // workers notice soon after.
+  atomic<long> incorrect(0);
+  atomic<long> at_most(static_cast<long>(width) * bmp1.height());
+  atomic<bool> decided(at_most.load() <= max_incorrect);
+  const size_t grain = max<size_t>(1, (1 << 16) / max<UINT>(width, 1));
+  pool.parallel_for(0, bmp1.height(), grain, [&](size_t start_y,
+                                                  size_t end_y) {
+    for (UINT y = start_y; y < end_y; ++y) {
+      if (decided.load(memory_order_relaxed)) {
+        return;
+      }
+      const long row_incorrect = incorrect_in_row(bmp1, bmp2, y, shared_width);
+      const long change = row_incorrect - static_cast<long>(width);
+      if (incorrect.fetch_add(row_incorrect) + row_incorrect > max_incorrect ||
+          at_most.fetch_add(change) + change <= max_incorrect) {
+        decided.store(true, memory_order_relaxed);
+      }
+    }
+  });
+  return incorrect.load() <= max_incorrect;
+}
+
+bool images_identical(BitMap& bmp1, BitMap& bmp2, ThreadPool& pool) {
+  return bmp1.width() == bmp2.width() && bmp1.height() == bmp2.height() &&
+         images_within_tolerance(bmp1, bmp2, 0, pool);
+}
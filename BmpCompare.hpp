@@ -0,0 +1,97 @@
+#ifndef BMPCOMPARE_HPP_
+#define BMPCOMPARE_HPP_
+
+#include <vector>
+#include "ThreadPool.hpp"
+#include "qdbmp.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// The comparison engine behind compare_bmp.
+//
+// Both images are walked row by row, so their pixel buffers are read
+// sequentially, and each row pair goes through the compare_rows() SIMD
+// kernel. Rows are split across the workers of a ThreadPool; each worker
+// adds into its own totals, which are summed once every row is done.
+///////////////////////////////////////////////////////////////////////////////
+
+// What comparing two images found
+struct CompareTotals {
+  long diff = 0;              // sum of the absolute channel differences
+  long correct_pixels = 0;    // pixels whose red, green and blue all match
+  long incorrect_pixels = 0;  // every other pixel
+};
+
+// How compare_images() draws where two images differ
+enum class DiffStyle {
+  kAbsolute,  // each channel's absolute difference, multiplied by a gain
+  kMask,      // red where the pixels differ, dark green where they match
+};
+
+// The gain of DiffStyle::kAbsolute unless another is asked for
+constexpr int kDefaultDiffGain = 8;
+
+// Differing pixels are grouped into boxes by cells of this many pixels
+// square: two differing pixels are in the same box if their cells touch,
+// even at a corner
+constexpr UINT kDiffCellSize = 16;
+
+// The smallest rectangle around a group of differing pixels
+struct DiffBox {
+  UINT x, y;           // the top left pixel
+  UINT width, height;
+  long pixels;         // the differing pixels inside
+};
+
+// Where compare_images() records where the images differ
+struct DiffOutput {
+  BitMap* image = nullptr;  // drawn into if set; at least as large as bmp1
+  DiffStyle style = DiffStyle::kAbsolute;
+  int gain = kDefaultDiffGain;  // from 1 to 255
+  std::vector<DiffBox> boxes;   // set by compare_images(), top to bottom
+};
+
+// Compares every pixel of bmp1 with the pixel at the same position in
+// bmp2. Pixels of bmp1 that are outside bmp2 are compared with black, and
+// pixels of bmp2 outside bmp1 are ignored.
+//
+// If diff is given, the same pass also draws the differences into
+// diff->image and boxes them in diff->boxes. Each row is then looked at a
+// second time while it is still in cache, but only if it has differing
+// pixels or an image is drawn.
+//
+// Arguments:
+// - bmp1, bmp2: the images to compare
+// - pool: the workers to split the rows between
+// - diff: where to record where the images differ, or nullptr
+//
+// Returns:
+// - the totals over every pixel of bmp1
+CompareTotals compare_images(BitMap& bmp1,
+                             BitMap& bmp2,
+                             ThreadPool& pool,
+                             DiffOutput* diff = nullptr);
+
+// Decides whether at most max_incorrect pixels of bmp1 differ from bmp2,
+// counting pixels the way compare_images() does. The workers stop as soon
+// as the answer is known: once more than max_incorrect pixels differ, or
+// once too few pixels are left unchecked for that to happen. Rows whose
+// bytes are all equal are skipped with memcmp.
+//
+// Arguments:
+// - bmp1, bmp2: the images to compare
+// - max_incorrect: the most pixels that may differ, at least 0
+// - pool: the workers to split the rows between
+//
+// Returns:
+// - true if at most max_incorrect pixels differ
+// - false otherwise
+bool images_within_tolerance(BitMap& bmp1,
+                             BitMap& bmp2,
+                             long max_incorrect,
+                             ThreadPool& pool);
+
+// Returns whether bmp1 and bmp2 have the same size and the same red, green
+// and blue in every pixel, stopping at the first row that differs
+bool images_identical(BitMap& bmp1, BitMap& bmp2, ThreadPool& pool);
+
+#endif  // BMPCOMPARE_HPP_
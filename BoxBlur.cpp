@@ -0,0 +1,351 @@
+#include "BoxBlur.hpp"
+#include <algorithm>
+#include <string>
+
+using namespace std;
+
+namespace {
+const string kModeFlag = "--mode=";
+}
+
+optional<BlurMode> parse_blur_mode(const string& flag) {
+  if (flag.rfind(kModeFlag, 0) != 0) {
+    return nullopt;
+  }
+  string name = flag.substr(kModeFlag.length());
+  if (name == "auto") {
+    return BlurMode::kAuto;
+  }
+  if (name == "naive") {
+    return BlurMode::kNaive;
+  }
+  if (name == "sat") {
+    return BlurMode::kSummedArea;
+  }
+  if (name == "separable") {
+    return BlurMode::kSeparable;
+  }
+  return nullopt;
+}
+
+BlurMode resolve_blur_mode(BlurMode mode, int block_size) {
+  if (mode != BlurMode::kAuto) {
+    return mode;
+  }
+  return block_size >= kSummedAreaMinBlockSize ? BlurMode::kSummedArea
+                                               : BlurMode::kNaive;
+}
+
+BlurMode resolve_parallel_blur_mode(BlurMode mode, int block_size) {
+  BlurMode resolved = resolve_blur_mode(mode, block_size);
+  if (mode == BlurMode::kAuto && resolved == BlurMode::kSummedArea) {
+    return BlurMode::kSeparable;
+  }
+  return resolved;
+}
+
+namespace {
+
+// Returns a pointer to the first byte of every row of image
+vector<const UCHAR*> row_pointers(BitMap& image) {
+  vector<const UCHAR*> rows(image.height());
+  for (UINT y = 0; y < rows.size(); ++y) {
+    rows[y] = image.row(y).data;
+  }
+  return rows;
+}
+
+// Writes the truncated average of the given channel totals into pixel x of
+// an output row.
+inline void store_average(const RowSpan& out,
+                          UINT x,
+                          uint32_t total_red,
+                          uint32_t total_green,
+                          uint32_t total_blue,
+                          UINT pixels_counter) {
+  UCHAR* pixel = out.pixel(x);
+  pixel[RowSpan::kRed] = static_cast<UCHAR>(total_red / pixels_counter);
+  pixel[RowSpan::kGreen] = static_cast<UCHAR>(total_green / pixels_counter);
+  pixel[RowSpan::kBlue] = static_cast<UCHAR>(total_blue / pixels_counter);
+}
+
+template <UINT BPP>
+void naive_rows(BitMap& image,
+                BitMap& blur,
+                int block_size,
+                UINT startY,
+                UINT endY) {
+  const int height = image.height();
+  const int width = image.width();
+  const vector<const UCHAR*> rows = row_pointers(image);
+
+  for (int y = startY; y <= static_cast<int>(endY); ++y) {
+    RowSpan out = blur.row(y);
+    for (int x = 0; x < width; ++x) {
+      unsigned int total_red = 0, total_green = 0, total_blue = 0;
+
+      // Calculate the neighborhood boundaries considering the block size
+      int neighborStartY = max(0, y - block_size);
+      int neighborEndY = min(y + block_size, height - 1);
+      int neighborStartX = max(0, x - block_size);
+      int neighborEndX = min(x + block_size, width - 1);
+
+      // Sum up the color values of all neighboring pixels
+      for (int yy = neighborStartY; yy <= neighborEndY; ++yy) {
+        const UCHAR* pixel = rows[yy] + neighborStartX * BPP;
+        for (int xx = neighborStartX; xx <= neighborEndX; ++xx) {
+          total_red += pixel[RowSpan::kRed];
+          total_green += pixel[RowSpan::kGreen];
+          total_blue += pixel[RowSpan::kBlue];
+          pixel += BPP;
+        }
+      }
+
+      UINT pixels_counter = (neighborEndY - neighborStartY + 1) *
+                            (neighborEndX - neighborStartX + 1);
+      store_average(out, x, total_red, total_green, total_blue,
+                    pixels_counter);
+    }
+  }
+}
+
+// Returns the number of pixels in the window [i - k, i + k] clipped to
+// [0, size - 1].
+inline UINT clipped_count(UINT i, UINT size, UINT k) {
+  return min(i + k, size - 1) - (i > k ? i - k : 0) + 1;
+}
+
+// The horizontal pass of the separable blur: writes into out the sums of
+// the windows [x - k, x + k], clipped to the row, of every column x in
+// [x0, x1] of a row of width pixels, as one red, green and blue sum per
+// column. The window is primed once and then slid one column at a time.
+template <UINT BPP>
+void row_window_sums(const UCHAR* in,
+                     UINT width,
+                     UINT k,
+                     UINT x0,
+                     UINT x1,
+                     uint32_t* out) {
+  // Prime the window of x0
+  uint32_t total_red = 0, total_green = 0, total_blue = 0;
+  for (UINT x = x0 > k ? x0 - k : 0; x <= min(x0 + k, width - 1); ++x) {
+    total_red += in[x * BPP + RowSpan::kRed];
+    total_green += in[x * BPP + RowSpan::kGreen];
+    total_blue += in[x * BPP + RowSpan::kBlue];
+  }
+
+  for (UINT x = x0; x <= x1; ++x) {
+    size_t here = (x - x0) * 3;
+    out[here] = total_red;
+    out[here + 1] = total_green;
+    out[here + 2] = total_blue;
+
+    // Slide the window one column to the right
+    if (x + k + 1 < width) {
+      const UCHAR* entering = in + (x + k + 1) * BPP;
+      total_red += entering[RowSpan::kRed];
+      total_green += entering[RowSpan::kGreen];
+      total_blue += entering[RowSpan::kBlue];
+    }
+    if (x >= k) {
+      const UCHAR* leaving = in + (x - k) * BPP;
+      total_red -= leaving[RowSpan::kRed];
+      total_green -= leaving[RowSpan::kGreen];
+      total_blue -= leaving[RowSpan::kBlue];
+    }
+  }
+}
+
+// The vertical pass of the separable blur: sums the horizontal window sums
+// of columns [x0, x1] down the windows [y - k, y + k], clipped to the
+// image, of every row y in [y0, y1], and writes their averages into blur.
+// sums_of(y) returns the row_window_sums() of columns [x0, x1] of row y;
+// only rows within k of [y0, y1] are asked for. Walking rows top to bottom
+// keeps memory access row-major.
+template <typename SumsOf>
+void column_window_averages(BitMap& blur,
+                            SumsOf sums_of,
+                            UINT width,
+                            UINT height,
+                            UINT k,
+                            UINT x0,
+                            UINT x1,
+                            UINT y0,
+                            UINT y1) {
+  // One running sum per channel of every column in the range
+  const size_t columns = x1 - x0 + 1;
+  vector<uint32_t> totals(columns * 3, 0);
+
+  // Prime the window of y0
+  for (UINT y = y0 > k ? y0 - k : 0; y <= min(y0 + k, height - 1); ++y) {
+    const uint32_t* entering = sums_of(y);
+    for (size_t i = 0; i < columns * 3; ++i) {
+      totals[i] += entering[i];
+    }
+  }
+
+  for (UINT y = y0;; ++y) {
+    UINT rows = clipped_count(y, height, k);
+    RowSpan out = blur.row(y);
+    for (UINT x = x0; x <= x1; ++x) {
+      size_t here = (x - x0) * 3;
+      store_average(out, x, totals[here], totals[here + 1], totals[here + 2],
+                    rows * clipped_count(x, width, k));
+    }
+    if (y == y1) {
+      break;
+    }
+
+    // Slide the window one row down
+    if (y + k + 1 < height) {
+      const uint32_t* entering = sums_of(y + k + 1);
+      for (size_t i = 0; i < columns * 3; ++i) {
+        totals[i] += entering[i];
+      }
+    }
+    if (y >= k) {
+      const uint32_t* leaving = sums_of(y - k);
+      for (size_t i = 0; i < columns * 3; ++i) {
+        totals[i] -= leaving[i];
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void blur_rows_naive(BitMap& image,
+                     BitMap& blur,
+                     int block_size,
+                     UINT startY,
+                     UINT endY) {
+  dispatch_pixel_size(image.bytes_per_pixel(), [&](auto bpp) {
+    naive_rows<bpp>(image, blur, block_size, startY, endY);
+  });
+}
+
+SummedAreaTable::SummedAreaTable(BitMap& image)
+    : width(image.width()),
+      height(image.height()),
+      sums(static_cast<size_t>(width + 1) * (height + 1) * 3, 0) {
+  // Row 0 and column 0 stay zero. Every other entry is the sum of the pixels
+  // in the current row up to x, plus the entry directly above it.
+  dispatch_pixel_size(image.bytes_per_pixel(), [&](auto bpp) {
+    for (UINT y = 0; y < height; ++y) {
+      const UCHAR* pixel = image.row(y).data;
+      const uint32_t* above = &sums[index(1, y)];
+      uint32_t* here = &sums[index(1, y + 1)];
+      uint32_t row_red = 0, row_green = 0, row_blue = 0;
+      for (UINT x = 0; x < width; ++x) {
+        row_red += pixel[RowSpan::kRed];
+        row_green += pixel[RowSpan::kGreen];
+        row_blue += pixel[RowSpan::kBlue];
+        here[x * 3] = above[x * 3] + row_red;
+        here[x * 3 + 1] = above[x * 3 + 1] + row_green;
+        here[x * 3 + 2] = above[x * 3 + 2] + row_blue;
+        pixel += bpp;
+      }
+    }
+  });
+}
+
+void SummedAreaTable::blur_rows(BitMap& blur,
+                                int block_size,
+                                UINT startY,
+                                UINT endY) const {
+  const UINT k = block_size;
+
+  for (UINT y = startY; y <= endY; ++y) {
+    UINT top = y > k ? y - k : 0;
+    UINT bottom = min(y + k, height - 1) + 1;
+    UINT rows = bottom - top;
+    RowSpan out = blur.row(y);
+
+    for (UINT x = 0; x < width; ++x) {
+      UINT left = x > k ? x - k : 0;
+      UINT right = min(x + k, width - 1) + 1;
+      UINT pixels_counter = rows * (right - left);
+
+      // Inclusion-exclusion over the four corners of the window
+      size_t a = index(left, top);
+      size_t b = index(right, top);
+      size_t c = index(left, bottom);
+      size_t d = index(right, bottom);
+      uint32_t total_red = sums[d] - sums[b] - sums[c] + sums[a];
+      uint32_t total_green =
+          sums[d + 1] - sums[b + 1] - sums[c + 1] + sums[a + 1];
+      uint32_t total_blue =
+          sums[d + 2] - sums[b + 2] - sums[c + 2] + sums[a + 2];
+
+      store_average(out, x, total_red, total_green, total_blue,
+                    pixels_counter);
+    }
+  }
+}
+
+SeparableBlur::SeparableBlur(UINT width, UINT height, int block_size)
+    : width(width),
+      height(height),
+      k(block_size),
+      row_sums(static_cast<size_t>(width) * height * 3, 0) {}
+
+void SeparableBlur::horizontal_pass(BitMap& image, UINT startY, UINT endY) {
+  dispatch_pixel_size(image.bytes_per_pixel(), [&](auto bpp) {
+    for (UINT y = startY; y <= endY; ++y) {
+      row_window_sums<bpp>(image.row(y).data, width, k, 0, width - 1,
+                           &row_sums[index(0, y)]);
+    }
+  });
+}
+
+void SeparableBlur::vertical_pass(BitMap& blur, UINT startX, UINT endX) const {
+  column_window_averages(
+      blur, [&](UINT y) { return &row_sums[index(startX, y)]; }, width,
+      height, k, startX, endX, 0, height - 1);
+}
+
+vector<Tile> make_tiles(UINT width,
+                        UINT height,
+                        UINT tile_width,
+                        UINT tile_height) {
+  vector<Tile> tiles;
+  for (UINT y = 0; y < height; y += tile_height) {
+    for (UINT x = 0; x < width; x += tile_width) {
+      tiles.push_back(Tile{x, y, min(x + tile_width, width) - 1,
+                           min(y + tile_height, height) - 1});
+    }
+  }
+  return tiles;
+}
+
+void blur_tile(BitMap& image,
+               BitMap& blur,
+               int block_size,
+               const Tile& tile,
+               vector<uint32_t>& scratch) {
+  const UINT width = image.width();
+  const UINT height = image.height();
+  const UINT k = block_size;
+
+  // Rows of the tile plus its vertical halo, clipped to the image
+  const UINT haloY0 = tile.y0 > k ? tile.y0 - k : 0;
+  const UINT haloY1 = min(tile.y1 + k, height - 1);
+  const UINT columns = tile.x1 - tile.x0 + 1;
+  scratch.resize(static_cast<size_t>(haloY1 - haloY0 + 1) * columns * 3);
+
+  // Horizontal pass: window sums of the tile's columns for every halo row,
+  // reading the horizontal halo as needed
+  auto sums_of = [&](UINT y) {
+    return &scratch[static_cast<size_t>(y - haloY0) * columns * 3];
+  };
+  dispatch_pixel_size(image.bytes_per_pixel(), [&](auto bpp) {
+    for (UINT y = haloY0; y <= haloY1; ++y) {
+      row_window_sums<bpp>(image.row(y).data, width, k, tile.x0, tile.x1,
+                           sums_of(y));
+    }
+  });
+
+  // Vertical pass: running column sums over the halo rows
+  column_window_averages(blur, sums_of, width, height, k, tile.x0, tile.x1,
+                         tile.y0, tile.y1);
+}
@@ -0,0 +1,160 @@
+#ifndef BOXBLUR_HPP_
+#define BOXBLUR_HPP_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "qdbmp.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Box blur kernels shared by blur_sequential and blur_parallel.
+//
+// Every kernel computes, for each output pixel (x, y), the truncated average
+// of the input pixels in the square [x - k, x + k] x [y - k, y + k] clipped to
+// the image, where k is the block size. The divisor is the clipped window
+// area, so all kernels produce byte-identical output.
+//
+// Each kernel works on a range of output rows [startY, endY] so that callers
+// can split an image between threads.
+///////////////////////////////////////////////////////////////////////////////
+
+// The available blur algorithms
+enum class BlurMode {
+  kAuto,        // pick the fastest algorithm for the block size
+  kNaive,       // sum the full neighborhood of every pixel
+  kSummedArea,  // look window sums up in a summed-area table
+  kSeparable,   // running window sums along rows, then along columns
+};
+
+// Block sizes at or above this value use the summed-area table in kAuto mode.
+// Below it the neighborhood is small enough that summing it directly is
+// cheaper than building the table.
+constexpr int kSummedAreaMinBlockSize = 3;
+
+// Parses a "--mode=<name>" command line flag.
+//
+// Arguments:
+// - flag: the command line argument, e.g. "--mode=sat"
+//
+// Returns:
+// - the selected mode for "naive", "sat", "separable" or "auto"
+// - nullopt if the flag is malformed or names an unknown mode
+std::optional<BlurMode> parse_blur_mode(const std::string& flag);
+
+// Resolves kAuto to a concrete algorithm for the given block size.
+// Any other mode is returned unchanged.
+BlurMode resolve_blur_mode(BlurMode mode, int block_size);
+
+// Resolves kAuto like resolve_blur_mode(), for a blur split between
+// threads: block sizes that would use the summed-area table use the
+// separable blur instead, since the table is built by a single thread
+// while both separable passes are split between threads.
+BlurMode resolve_parallel_blur_mode(BlurMode mode, int block_size);
+
+// Blurs rows [startY, endY] of image into blur by summing every pixel of
+// each neighborhood. Cost per pixel is O(block_size^2).
+void blur_rows_naive(BitMap& image,
+                     BitMap& blur,
+                     int block_size,
+                     UINT startY,
+                     UINT endY);
+
+// A summed-area table (integral image) of the red, green and blue channels
+// of a BitMap. Once built, the sum of any rectangle of pixels is found with
+// four lookups, so blurring costs O(1) per pixel regardless of block size.
+//
+// The table is read-only after construction, so several threads may call
+// blur_rows() on the same table concurrently.
+class SummedAreaTable {
+ public:
+  // Builds the table from every pixel of image.
+  explicit SummedAreaTable(BitMap& image);
+
+  // Blurs rows [startY, endY] of the image the table was built from
+  // and writes the result into blur.
+  void blur_rows(BitMap& blur, int block_size, UINT startY, UINT endY) const;
+
+ private:
+  // Returns the index of the red sum of all pixels above row y and left of
+  // column x. Green and blue follow at +1 and +2.
+  size_t index(UINT x, UINT y) const {
+    return (static_cast<size_t>(y) * (width + 1) + x) * 3;
+  }
+
+  // Fields
+  UINT width;
+  UINT height;
+
+  // Sums are kept modulo 2^32, the same width as the accumulators of the
+  // naive kernel. Window sums computed from the table are exact modulo 2^32
+  // as well, so the two kernels agree even if a huge window overflows.
+  std::vector<uint32_t> sums;
+};
+
+// A separable box blur. A box window is the product of a horizontal and a
+// vertical window, so the blur is done in two passes that each keep a
+// running sum: adding the pixel entering the window and subtracting the one
+// leaving it. Total work is O(width * height) regardless of block size.
+//
+// The horizontal pass writes per-row window sums into an intermediate
+// buffer and the vertical pass sums those down each column. Both passes
+// take a disjoint range (rows, then columns), so threads may run either pass
+// concurrently as long as every horizontal pass finishes before any vertical
+// pass starts.
+class SeparableBlur {
+ public:
+  // Allocates the intermediate buffer for an image of the given size.
+  SeparableBlur(UINT width, UINT height, int block_size);
+
+  // Computes horizontal window sums of rows [startY, endY] of image.
+  void horizontal_pass(BitMap& image, UINT startY, UINT endY);
+
+  // Sums the horizontal window sums of columns [startX, endX] vertically,
+  // divides by the clipped window area and writes the result into blur.
+  void vertical_pass(BitMap& blur, UINT startX, UINT endX) const;
+
+ private:
+  // Returns the index of the red horizontal sum of pixel (x, y).
+  // Green and blue follow at +1 and +2.
+  size_t index(UINT x, UINT y) const {
+    return (static_cast<size_t>(y) * width + x) * 3;
+  }
+
+  // Fields
+  UINT width;
+  UINT height;
+  UINT k;
+  std::vector<uint32_t> row_sums;
+};
+
+// A rectangle of output pixels [x0, x1] x [y0, y1], inclusive
+struct Tile {
+  UINT x0;
+  UINT y0;
+  UINT x1;
+  UINT y1;
+};
+
+// Cuts a width x height image into tiles of at most tile_width x
+// tile_height pixels, in row-major order.
+std::vector<Tile> make_tiles(UINT width,
+                             UINT height,
+                             UINT tile_width,
+                             UINT tile_height);
+
+// Blurs one tile of image into blur with a separable blur that only reads
+// the tile plus a halo of block_size rows and columns around it. The
+// intermediate sums of a tile fit in cache when the tile is small enough,
+// unlike those of SeparableBlur, which span whole rows.
+//
+// Arguments:
+// - scratch: buffer for the intermediate sums, grown as needed. Reuse one
+//   per thread to avoid allocating per tile.
+void blur_tile(BitMap& image,
+               BitMap& blur,
+               int block_size,
+               const Tile& tile,
+               std::vector<uint32_t>& scratch);
+
+#endif  // BOXBLUR_HPP_
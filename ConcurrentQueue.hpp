@@ -0,0 +1,725 @@
+#ifndef CONCURRENTQUEUE_HPP_
+#define CONCURRENTQUEUE_HPP_
+
+#include <pthread.h>
+#include <time.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// A ConcurrentQueue<T> is a class that represents a queue of T values
+//
+// The queue supports:
+// - adding values to the end of the queue, by copy, by move or by
+//   constructing them in place
+// - removing values from the front of the queue
+// - removing a value from the front of the queue and waiting
+//   for a value to be added if there isn't one already, optionally
+//   giving up at a deadline or when a stop token is stopped
+// - adding or removing many values at once, with a single lock
+//   acquisition for the whole batch
+// Adding a value wakes at most one waiting thread, rather than all of
+// them, so many idle consumers do not all wake up for each value.
+// The queue is thread safe, with no potential for data races, or deadlocks
+//
+// Values are moved in and out of the queue, so T only needs to be move
+// constructible; large payloads and move-only types such as unique_ptr pass
+// through without being copied.
+///////////////////////////////////////////////////////////////////////////////
+
+// What a bounded ConcurrentQueue does with a value added while it is full
+enum class QueueFullPolicy {
+  kBlock,       // wait for a value to be removed (try_add() fails instead)
+  kDropOldest,  // discard the value at the front of the queue to make room
+};
+
+template <typename T>
+class ConcurrentQueue {
+ public:
+  // A capacity that means the queue has no size limit
+  static constexpr size_t kUnbounded = 0;
+
+  // Constructor for a ConcurrentQueue.
+  // Initializes the queue to be empty
+  // and ready to handle concurrent operations
+  //
+  // Arguments:
+  // - capacity: the most values the queue holds at once, or kUnbounded
+  // - policy: what adding to a full queue does; ignored if unbounded
+  explicit ConcurrentQueue(size_t capacity = kUnbounded,
+                           QueueFullPolicy policy = QueueFullPolicy::kBlock);
+
+  // Destructor for ConcurrentQueue.
+  // Destroys any remaining values in the queue
+  // and any synchronization methods used for maintaining
+  // the state of the queue.
+  ~ConcurrentQueue();
+
+  // Adds a value to the end of the queue. If the queue is full, the
+  // calling thread blocks until there is room or the queue is closed, or
+  // the oldest value is dropped, depending on the queue's policy.
+  // This operation is thread safe.
+  //
+  // Arguments:
+  // - val: the value to add to the end of the queue. It is moved into the
+  //   queue if it is an rvalue.
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed
+  bool add(const T& val) { return emplace(val); }
+  bool add(T&& val) { return emplace(std::move(val)); }
+
+  // Constructs a value in place at the end of the queue, waiting for room
+  // like add()
+  // This operation is thread safe.
+  //
+  // Arguments:
+  // - args: the arguments to pass to the constructor of T
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed, in which case no value is constructed
+  template <typename... Args>
+  bool emplace(Args&&... args);
+
+  // Same as add() and emplace(), but never block: if the queue is full and
+  // its policy is kBlock, they fail instead.
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed or full
+  bool try_add(const T& val) { return try_emplace(val); }
+  bool try_add(T&& val) { return try_emplace(std::move(val)); }
+  template <typename... Args>
+  bool try_emplace(Args&&... args);
+
+  // Adds a copy of every value of vals to the end of the queue, in order.
+  // The lock is taken once for the whole batch, unless a bounded queue
+  // fills up and has to wait for room, in which case the batch is added in
+  // several steps.
+  // This operation is thread safe.
+  //
+  // Arguments:
+  // - vals: the values to add to the end of the queue
+  //
+  // Returns:
+  // - the number of values added: vals.size() if the operation is
+  //   successful, fewer if the queue is closed part way, 0 if it was
+  //   closed already
+  size_t add_bulk(std::span<const T> vals);
+
+  // Closes the queue.
+  //
+  // Any calls to add() that happens after calling close should fail
+  // and return false.
+  //
+  // calls to remove() or wait_remove() should return nullopt
+  // if there are no elements in the queue left.
+  //
+  // Threads blocked on wait_remove() will be waken up to either
+  // process any values left in the queue or return nullopt
+  void close();
+
+  // Removes a value from the front of the queue without waiting
+  // This operation is thread safe.
+  //
+  // Arguments: None
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if there were no values in the queue
+  std::optional<T> try_remove();
+
+  // Same as try_remove()
+  std::optional<T> remove() { return try_remove(); }
+
+  // Removes a value from the front of the queue but if there is no value
+  // in the queue, calling thread will block until there is a value
+  // available. If the the queue is closed and the queue is empty, then it
+  // returns nullopt instead.
+  //
+  // This operation is thread safe.
+  //
+  // Arguments: None
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if the queue is closed and empty
+  std::optional<T> wait_remove();
+
+  // Same as wait_remove(), but also gives up if token is stopped while the
+  // queue is empty, without closing the queue for other consumers.
+  //
+  // Arguments:
+  // - token: stops the wait when stop is requested on its source
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if the queue is empty and either closed or token is stopped
+  std::optional<T> wait_remove(std::stop_token token);
+
+  // Same as wait_remove(), but gives up once timeout has passed.
+  // Timeouts are measured on the monotonic clock, so changes to the system
+  // time do not shorten or extend them.
+  //
+  // Arguments:
+  // - timeout: the longest time to wait for a value
+  // - token: stops the wait early when stop is requested on its source
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if the queue is still empty when the timeout passes, the
+  //   queue is closed or token is stopped
+  template <typename Rep, typename Period>
+  std::optional<T> wait_remove_for(std::chrono::duration<Rep, Period> timeout,
+                                   std::stop_token token = {});
+
+  // Same as wait_remove_for(), but gives up at deadline instead of after a
+  // timeout.
+  template <typename Duration>
+  std::optional<T> wait_remove_until(
+      std::chrono::time_point<std::chrono::steady_clock, Duration> deadline,
+      std::stop_token token = {});
+
+  // Moves up to max values from the front of the queue into out, in
+  // order, under a single lock acquisition. If there is no value in the
+  // queue, calling thread will block until there is at least one, then
+  // takes as many as are available up to the limit.
+  //
+  // This operation is thread safe.
+  //
+  // Arguments:
+  // - out: An output parameter that receives the removed values
+  // - max: the most values to remove; out.size() is used if it is smaller
+  //
+  // Returns:
+  // - the number of values written to the front of out
+  // - 0 if the queue is closed and empty
+  size_t wait_remove_bulk(std::span<T> out, size_t max);
+
+  // Returns the length of the queue currently
+  // This operation is thread safe.
+  //
+  // Arguments: None
+  //
+  // Returns:
+  // The value length of (i.e. number of elements in) the queue
+  int length();
+
+  // Returns the most values the queue holds at once, or kUnbounded
+  size_t capacity() const { return maxSize; }
+
+  // Returns how many values the kDropOldest policy has discarded so far
+  // This operation is thread safe.
+  size_t dropped();
+
+  // Feel free to ignore these
+  ConcurrentQueue(const ConcurrentQueue& other) = delete;
+  ConcurrentQueue& operator=(const ConcurrentQueue& other) = delete;
+  ConcurrentQueue(ConcurrentQueue&& other) = delete;
+  ConcurrentQueue& operator=(ConcurrentQueue&& other) = delete;
+
+ private:
+  // define a new internal type used to represent
+  // nodes in the Queue
+  // Queue can be implemented as a linked list.
+  // The value is only constructed while the node is in the queue, so that
+  // pooled nodes do not need T to be default constructible.
+  struct QueueNode {
+    QueueNode* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T& value() { return *std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  // Nodes are carved out of slabs of this many nodes. Removed nodes go back
+  // on a free list and are reused, so once the queue has grown to its
+  // working size, adding and removing never touches the heap.
+  static constexpr size_t kSlabNodes = 256;
+
+  // Wakes every waiting thread when a stop token is stopped, so that they
+  // can see the stop request
+  struct StopWaker {
+    ConcurrentQueue* queue;
+    void operator()() const {
+      Guard guard(*queue);
+      queue->notifyAllWaiters();
+    }
+  };
+
+  // Holds the queue lock for the lifetime of the guard, so that the lock is
+  // released even if constructing or moving a T throws
+  class Guard {
+   public:
+    explicit Guard(ConcurrentQueue& queue) : queue(queue) {
+      queue.lockQueue();
+    }
+    ~Guard() { queue.unlockQueue(); }
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    ConcurrentQueue& queue;
+  };
+
+  // Fields
+  QueueNode* head;
+  QueueNode* tail;
+  int size;
+  bool isClosed;
+  int waiters;  // threads blocked in waitForItems() or waitForItemsUntil()
+
+  // The size limit, and the producers blocked waiting for room under it
+  size_t maxSize;
+  QueueFullPolicy fullPolicy;
+  size_t droppedCount;
+  int spaceWaiters;
+  pthread_cond_t notFull;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  // The node pool: unused nodes linked through next, and the slabs that
+  // own every node
+  QueueNode* freeNodes;
+  std::vector<std::unique_ptr<QueueNode[]>> slabs;
+
+  // Helper methods
+  void lockQueue();
+  void unlockQueue();
+  void waitForItems();
+  bool waitForItemsUntil(const timespec& deadline);
+  void notifyWaiters(size_t count);
+  void notifyAllWaiters();
+  bool makeRoom(bool wait);
+  void notifySpace(size_t count);
+  template <typename... Args>
+  bool coreEmplace(bool wait, Args&&... args);
+  std::optional<T> stoppableRemove(const timespec* deadline,
+                                   const std::stop_token& token);
+
+  // Assumes the mutex is already locked
+  void append(QueueNode* first, QueueNode* last, size_t count);
+  std::optional<T> coreRemove();
+
+  // Node pool helpers: Assume the mutex is already locked
+  template <typename... Args>
+  QueueNode* allocateNode(Args&&... args);
+  void releaseNodes(QueueNode* first, QueueNode* last);
+  void growPool();
+};
+
+template <typename T>
+ConcurrentQueue<T>::ConcurrentQueue(size_t capacity, QueueFullPolicy policy)
+    : head(nullptr),
+      tail(nullptr),
+      size(0),
+      isClosed(false),
+      waiters(0),
+      maxSize(capacity),
+      fullPolicy(policy),
+      droppedCount(0),
+      spaceWaiters(0),
+      freeNodes(nullptr) {
+  pthread_mutex_init(&mutex, nullptr);
+  // Timed waits take deadlines on the monotonic clock
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cond, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_cond_init(&notFull, nullptr);
+  growPool();  // Start with one slab so short-lived queues never grow
+}
+
+template <typename T>
+ConcurrentQueue<T>::~ConcurrentQueue() {
+  // The slabs free every node, but queued values must be destroyed first
+  for (QueueNode* node = head; node != nullptr; node = node->next) {
+    node->value().~T();
+  }
+  pthread_mutex_destroy(&mutex);
+  pthread_cond_destroy(&cond);
+  pthread_cond_destroy(&notFull);
+}
+
+template <typename T>
+void ConcurrentQueue<T>::lockQueue() {
+  pthread_mutex_lock(&mutex);
+}
+
+template <typename T>
+void ConcurrentQueue<T>::unlockQueue() {
+  pthread_mutex_unlock(&mutex);
+}
+
+template <typename T>
+void ConcurrentQueue<T>::waitForItems() {
+  waiters++;
+  pthread_cond_wait(&cond, &mutex);
+  waiters--;
+}
+
+// Returns false if deadline, on CLOCK_MONOTONIC, passed before a wakeup
+template <typename T>
+bool ConcurrentQueue<T>::waitForItemsUntil(const timespec& deadline) {
+  waiters++;
+  int result = pthread_cond_timedwait(&cond, &mutex, &deadline);
+  waiters--;
+  return result != ETIMEDOUT;
+}
+
+// Wakes one waiting thread per added value, and none if no thread is
+// waiting. A woken thread always takes a value if one is left, even if it
+// timed out or was stopped at the same time, so no value is left queued
+// while other threads sleep.
+template <typename T>
+void ConcurrentQueue<T>::notifyWaiters(size_t count) {
+  if (waiters == 0) {
+    return;
+  }
+  if (count >= static_cast<size_t>(waiters)) {
+    pthread_cond_broadcast(&cond);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    pthread_cond_signal(&cond);
+  }
+}
+
+// Wakes every waiting thread, for changes that concern all of them
+template <typename T>
+void ConcurrentQueue<T>::notifyAllWaiters() {
+  if (waiters > 0) {
+    pthread_cond_broadcast(&cond);
+  }
+}
+
+// Constructs a value at the end of the queue, waiting for room if needed
+template <typename T>
+template <typename... Args>
+bool ConcurrentQueue<T>::emplace(Args&&... args) {
+  return coreEmplace(true, std::forward<Args>(args)...);
+}
+
+// Constructs a value at the end of the queue unless it is full
+template <typename T>
+template <typename... Args>
+bool ConcurrentQueue<T>::try_emplace(Args&&... args) {
+  return coreEmplace(false, std::forward<Args>(args)...);
+}
+
+// Adds a batch of values to the end of the queue
+template <typename T>
+size_t ConcurrentQueue<T>::add_bulk(std::span<const T> vals) {
+  Guard guard(*this);
+  size_t added = 0;
+  while (added < vals.size() && makeRoom(true)) {
+    // Add as much of the rest as fits
+    size_t count = vals.size() - added;
+    if (maxSize != kUnbounded) {
+      count = std::min(count, maxSize - static_cast<size_t>(size));
+    }
+    // Link the values from pooled nodes, then splice them on. If a copy
+    // throws, the values copied so far in this step are destroyed.
+    QueueNode* first = allocateNode(vals[added]);
+    QueueNode* last = first;
+    try {
+      for (size_t i = 1; i < count; ++i) {
+        last->next = allocateNode(vals[added + i]);
+        last = last->next;
+      }
+    } catch (...) {
+      for (QueueNode* node = first; node != nullptr; node = node->next) {
+        node->value().~T();
+      }
+      releaseNodes(first, last);
+      throw;
+    }
+    append(first, last, count);
+    added += count;
+  }
+  return added;
+}
+
+// Closes the queue.
+template <typename T>
+void ConcurrentQueue<T>::close() {
+  Guard guard(*this);
+  isClosed = true;
+  notifyAllWaiters();
+  if (spaceWaiters > 0) {
+    pthread_cond_broadcast(&notFull);  // Blocked producers fail
+  }
+}
+
+// Removes a value from the front of the queue
+template <typename T>
+std::optional<T> ConcurrentQueue<T>::try_remove() {
+  Guard guard(*this);
+  return coreRemove();
+}
+
+// Removes a value from the front of the queue but if there is no value
+// in the queue, calling thread will block until there is a value
+// available. If the the queue is closed and the queue is empty, then it
+// returns nullopt instead.
+template <typename T>
+std::optional<T> ConcurrentQueue<T>::wait_remove() {
+  Guard guard(*this);
+  while (size == 0 && !isClosed) {
+    waitForItems();  // Wait for items if the queue is empty and not closed.
+  }
+  return coreRemove();  // nullopt if the queue is closed and empty
+}
+
+template <typename T>
+std::optional<T> ConcurrentQueue<T>::wait_remove(std::stop_token token) {
+  return stoppableRemove(nullptr, token);
+}
+
+template <typename T>
+template <typename Rep, typename Period>
+std::optional<T> ConcurrentQueue<T>::wait_remove_for(
+    std::chrono::duration<Rep, Period> timeout,
+    std::stop_token token) {
+  return wait_remove_until(
+      std::chrono::steady_clock::now() +
+          std::chrono::ceil<std::chrono::steady_clock::duration>(timeout),
+      std::move(token));
+}
+
+// steady_clock is CLOCK_MONOTONIC on Linux, so its time points convert
+// directly into deadlines for the condition variable
+template <typename T>
+template <typename Duration>
+std::optional<T> ConcurrentQueue<T>::wait_remove_until(
+    std::chrono::time_point<std::chrono::steady_clock, Duration> deadline,
+    std::stop_token token) {
+  auto since_epoch = std::chrono::ceil<std::chrono::nanoseconds>(
+      deadline.time_since_epoch());
+  auto seconds = std::chrono::floor<std::chrono::seconds>(since_epoch);
+  timespec ts;
+  ts.tv_sec = static_cast<time_t>(seconds.count());
+  ts.tv_nsec = static_cast<long>((since_epoch - seconds).count());
+  return stoppableRemove(&ts, token);
+}
+
+// Private method: waits like wait_remove() until a value is available,
+// the queue is closed, deadline passes (if not null) or token is stopped
+template <typename T>
+std::optional<T> ConcurrentQueue<T>::stoppableRemove(
+    const timespec* deadline,
+    const std::stop_token& token) {
+  // Registered before taking the lock: if stop was already requested the
+  // waker runs right away, and it takes the lock itself
+  std::stop_callback<StopWaker> waker(token, StopWaker{this});
+  Guard guard(*this);
+  while (size == 0 && !isClosed && !token.stop_requested()) {
+    if (deadline == nullptr) {
+      waitForItems();
+    } else if (!waitForItemsUntil(*deadline)) {
+      break;  // Timed out
+    }
+  }
+  return coreRemove();  // nullopt if the queue is still empty
+}
+
+// Removes up to max values from the front of the queue, waiting for at
+// least one unless the queue is closed and empty
+template <typename T>
+size_t ConcurrentQueue<T>::wait_remove_bulk(std::span<T> out, size_t max) {
+  max = std::min(max, out.size());
+  if (max == 0) {
+    return 0;
+  }
+  Guard guard(*this);
+  while (size == 0 && !isClosed) {
+    waitForItems();  // Wait for items if the queue is empty and not closed.
+  }
+  // Move the batch out, then hand its nodes back to the pool in one splice.
+  // If a move throws, the values moved so far still count as removed.
+  QueueNode* first = head;
+  QueueNode* last = nullptr;
+  size_t count = 0;
+  auto unlinkMoved = [&] {
+    if (head == nullptr) {
+      tail = nullptr;
+    }
+    size -= static_cast<int>(count);
+    if (count > 0) {
+      releaseNodes(first, last);
+      notifySpace(count);
+    }
+  };
+  try {
+    while (count < max && head != nullptr) {
+      out[count] = std::move(head->value());
+      head->value().~T();
+      last = head;
+      head = head->next;
+      count++;
+    }
+  } catch (...) {
+    unlinkMoved();
+    throw;
+  }
+  unlinkMoved();
+  return count;
+}
+
+// Returns the current length of the queue
+template <typename T>
+int ConcurrentQueue<T>::length() {
+  Guard guard(*this);
+  return size;
+}
+
+// Returns how many values have been dropped to make room
+template <typename T>
+size_t ConcurrentQueue<T>::dropped() {
+  Guard guard(*this);
+  return droppedCount;
+}
+
+// Private method: Assumes the mutex is already locked
+// Makes sure there is room for at least one more value: drops the oldest
+// value under kDropOldest, otherwise waits for a value to be removed if
+// wait is true.
+// Returns false if the queue is closed, or full and wait is false.
+template <typename T>
+bool ConcurrentQueue<T>::makeRoom(bool wait) {
+  while (!isClosed && maxSize != kUnbounded &&
+         static_cast<size_t>(size) >= maxSize) {
+    if (fullPolicy == QueueFullPolicy::kDropOldest) {
+      coreRemove();  // The removed value is destroyed right away
+      droppedCount++;
+    } else if (!wait) {
+      return false;
+    } else {
+      spaceWaiters++;
+      pthread_cond_wait(&notFull, &mutex);
+      spaceWaiters--;
+    }
+  }
+  return !isClosed;
+}
+
+// Private method: Assumes the mutex is already locked
+// Wakes one producer waiting for room per removed value
+template <typename T>
+void ConcurrentQueue<T>::notifySpace(size_t count) {
+  if (spaceWaiters == 0) {
+    return;
+  }
+  if (count >= static_cast<size_t>(spaceWaiters)) {
+    pthread_cond_broadcast(&notFull);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    pthread_cond_signal(&notFull);
+  }
+}
+
+// Private method: constructs a value at the end of the queue once there is
+// room for it, waiting for room only if wait is true
+template <typename T>
+template <typename... Args>
+bool ConcurrentQueue<T>::coreEmplace(bool wait, Args&&... args) {
+  Guard guard(*this);
+  if (!makeRoom(wait)) {
+    return false;
+  }
+  QueueNode* node = allocateNode(std::forward<Args>(args)...);
+  append(node, node, 1);
+  return true;
+}
+
+// Private method: Assumes the mutex is already locked
+// Links the chain of count nodes first..last to the end of the queue and
+// wakes a waiting thread for each of them
+template <typename T>
+void ConcurrentQueue<T>::append(QueueNode* first,
+                                QueueNode* last,
+                                size_t count) {
+  if (tail == nullptr) {  // If queue is empty
+    head = first;         // The chain now starts the queue
+  } else {
+    tail->next = first;  // If not empty, append the chain at the end
+  }
+  tail = last;  // Update the tail pointer
+  size += static_cast<int>(count);
+  notifyWaiters(count);
+}
+
+// Private method: Assumes the mutex is already locked
+template <typename T>
+std::optional<T> ConcurrentQueue<T>::coreRemove() {
+  // If queue is empty, then nothing to remove
+  if (size == 0) {
+    return std::nullopt;
+  }
+  // else, remove a value from the front of the queue
+  QueueNode* temp = head;  // Hold the current head
+  std::optional<T> value(std::move(temp->value()));  // Extract its value
+  temp->value().~T();
+  head = head->next;  // Move head to the next node
+  if (head == nullptr) {
+    tail = nullptr;  // If the queue is now empty, tail is also null
+  }
+  releaseNodes(temp, temp);  // Return the removed node to the pool
+  size--;                    // Decrease the queue size
+  notifySpace(1);            // Let a producer waiting for room go on
+  return value;              // Return the value of the removed node
+}
+
+// Private method: Assumes the mutex is already locked
+// Takes a node from the pool, growing it by a slab if it is empty, and
+// constructs its value from args
+template <typename T>
+template <typename... Args>
+typename ConcurrentQueue<T>::QueueNode* ConcurrentQueue<T>::allocateNode(
+    Args&&... args) {
+  if (freeNodes == nullptr) {
+    growPool();
+  }
+  QueueNode* node = freeNodes;
+  new (node->storage) T(std::forward<Args>(args)...);
+  // Only take the node once the value is built, so a throwing
+  // constructor leaves the pool unchanged
+  freeNodes = node->next;
+  node->next = nullptr;
+  return node;
+}
+
+// Private method: Assumes the mutex is already locked
+// Puts the chain of nodes first..last back on the free list. Their values
+// must already be destroyed.
+template <typename T>
+void ConcurrentQueue<T>::releaseNodes(QueueNode* first, QueueNode* last) {
+  last->next = freeNodes;
+  freeNodes = first;
+}
+
+// Private method: Assumes the mutex is already locked
+// Adds a slab of kSlabNodes nodes to the free list
+template <typename T>
+void ConcurrentQueue<T>::growPool() {
+  slabs.push_back(std::make_unique<QueueNode[]>(kSlabNodes));
+  QueueNode* slab = slabs.back().get();
+  for (size_t i = 0; i + 1 < kSlabNodes; ++i) {
+    slab[i].next = &slab[i + 1];
+  }
+  releaseNodes(&slab[0], &slab[kSlabNodes - 1]);
+}
+
+#endif  // CONCURRENTQUEUE_HPP_
@@ -0,0 +1,175 @@
+/* A bounded multi-producer multi-consumer queue of doubles on a ring of
+   sequence-numbered slots, after Dmitry Vyukov's bounded MPMC queue. */
+
+#include "DoubleRingQueue.hpp"
+#include <algorithm>
+#include <bit>
+#include <optional>
+
+using namespace std;
+
+DoubleRingQueue::DoubleRingQueue(size_t capacity)
+    : mask(bit_ceil(max<size_t>(capacity, 2)) - 1),
+      slots(make_unique<Slot[]>(mask + 1)) {
+  // Every slot starts out free for the first lap of producers
+  for (size_t i = 0; i <= mask; ++i) {
+    slots[i].sequence.store(i, memory_order_relaxed);
+  }
+}
+
+// Adds a double to the end of the queue, waiting while it is full
+bool DoubleRingQueue::add(double val) {
+  while (true) {
+    Attempt attempt = try_add(val);
+    if (attempt == Attempt::kEmptyOrFull) {
+      // Announce the wait before checking again, so that a consumer freeing
+      // a slot after the check is sure to see this thread and wake it
+      producersWaiting.fetch_add(1);
+      atomic_thread_fence(memory_order_seq_cst);
+      uint32_t epoch = spaceEpoch.load();
+      attempt = try_add(val);
+      if (attempt == Attempt::kEmptyOrFull) {
+        spaceEpoch.wait(epoch);
+      }
+      producersWaiting.fetch_sub(1);
+    }
+    if (attempt == Attempt::kDone) {
+      notify(itemsEpoch, consumersWaiting);
+      return true;
+    }
+    if (attempt == Attempt::kClosed) {
+      return false;
+    }
+  }
+}
+
+// Closes the queue.
+void DoubleRingQueue::close() {
+  enqueuePos.fetch_or(kClosedBit);
+  // Wake every sleeping thread so it can see the queue is closed
+  itemsEpoch.fetch_add(1);
+  itemsEpoch.notify_all();
+  spaceEpoch.fetch_add(1);
+  spaceEpoch.notify_all();
+}
+
+// Removes a double from the front of the queue
+optional<double> DoubleRingQueue::remove() {
+  double val;
+  if (try_remove(val) != Attempt::kDone) {
+    return nullopt;
+  }
+  notify(spaceEpoch, producersWaiting);
+  return val;
+}
+
+// Removes a double from the front of the queue, waiting while it is empty
+// and open
+optional<double> DoubleRingQueue::wait_remove() {
+  double val;
+  while (true) {
+    Attempt attempt = try_remove(val);
+    if (attempt == Attempt::kEmptyOrFull) {
+      consumersWaiting.fetch_add(1);
+      atomic_thread_fence(memory_order_seq_cst);
+      uint32_t epoch = itemsEpoch.load();
+      attempt = try_remove(val);
+      if (attempt == Attempt::kEmptyOrFull) {
+        itemsEpoch.wait(epoch);
+      }
+      consumersWaiting.fetch_sub(1);
+    }
+    if (attempt == Attempt::kDone) {
+      notify(spaceEpoch, producersWaiting);
+      return val;
+    }
+    if (attempt == Attempt::kClosed) {
+      return nullopt;
+    }
+  }
+}
+
+// Returns the current length of the queue. Values still being written by
+// a producer are counted.
+int DoubleRingQueue::length() {
+  size_t dequeued = dequeuePos.load();
+  size_t enqueued = enqueuePos.load() & ~kClosedBit;
+  return enqueued > dequeued ? static_cast<int>(enqueued - dequeued) : 0;
+}
+
+// Private method: claims the next producer position and writes val to its
+// slot, or reports that the ring is full or closed
+DoubleRingQueue::Attempt DoubleRingQueue::try_add(double val) {
+  size_t pos = enqueuePos.load(memory_order_relaxed);
+  while (true) {
+    if ((pos & kClosedBit) != 0) {
+      return Attempt::kClosed;
+    }
+    Slot& slot = slots[pos & mask];
+    size_t sequence = slot.sequence.load(memory_order_acquire);
+    auto lap = static_cast<ptrdiff_t>(sequence - pos);
+    if (lap == 0) {
+      // The slot is free for this lap; claim it
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                           memory_order_relaxed)) {
+        slot.value = val;
+        slot.sequence.store(pos + 1, memory_order_release);
+        return Attempt::kDone;
+      }
+    } else if (lap < 0) {
+      // The slot still holds a value from the previous lap
+      return Attempt::kEmptyOrFull;
+    } else {
+      // Another producer claimed this position first
+      pos = enqueuePos.load(memory_order_relaxed);
+    }
+  }
+}
+
+// Private method: claims the next consumer position and reads its value,
+// or reports that the ring is empty, or closed and drained
+DoubleRingQueue::Attempt DoubleRingQueue::try_remove(double& val) {
+  size_t pos = dequeuePos.load(memory_order_relaxed);
+  while (true) {
+    Slot& slot = slots[pos & mask];
+    size_t sequence = slot.sequence.load(memory_order_acquire);
+    auto lap = static_cast<ptrdiff_t>(sequence - (pos + 1));
+    if (lap == 0) {
+      // The slot holds a value for this lap; claim it
+      if (dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                           memory_order_relaxed)) {
+        val = slot.value;
+        // Free the slot for the producer one lap ahead
+        slot.sequence.store(pos + mask + 1, memory_order_release);
+        return Attempt::kDone;
+      }
+    } else if (lap < 0) {
+      // Nothing written here yet
+      return closed_and_drained() ? Attempt::kClosed : Attempt::kEmptyOrFull;
+    } else {
+      // Another consumer claimed this position first
+      pos = dequeuePos.load(memory_order_relaxed);
+    }
+  }
+}
+
+// Private method: true once the queue is closed and every value that was
+// added before close() has been removed. A position claimed but not yet
+// written still counts as a value, so it is never left behind.
+bool DoubleRingQueue::closed_and_drained() const {
+  size_t enqueued = enqueuePos.load();
+  return (enqueued & kClosedBit) != 0 &&
+         dequeuePos.load() >= (enqueued & ~kClosedBit);
+}
+
+// Private method: wakes one thread sleeping on epoch, if there is any.
+// The fence orders the slot update made by the caller before the read of
+// waiters, pairing with the fence in the waiting thread.
+void DoubleRingQueue::notify(atomic<uint32_t>& epoch,
+                             const atomic<int>& waiters) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (waiters.load(memory_order_relaxed) > 0) {
+    epoch.fetch_add(1);
+    epoch.notify_one();
+  }
+}
@@ -0,0 +1,142 @@
+#ifndef DOUBLERINGQUEUE_HPP_
+#define DOUBLERINGQUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+///////////////////////////////////////////////////////////////////////////////
+// A DoubleRingQueue is a bounded queue of double values with the same
+// contract as DoubleQueue, built on a lock-free ring buffer instead of a
+// locked linked list.
+//
+// The queue supports:
+// - adding doubles to the end of the queue, waiting for room if it is full
+// - removing doubles from the front of the queue
+// - removing a double from the front of the queue and waiting
+//   for a double to be added if there isn't one already.
+// The queue is thread safe for any number of producers and consumers.
+//
+// Every slot of the ring carries a sequence number that tells whether it is
+// ready to be written or read for a given lap around the ring, so producers
+// and consumers only contend on one atomic counter each and never take a
+// lock. Threads only sleep, on a futex, when the ring is empty or full, and
+// are only woken if some thread is actually sleeping.
+///////////////////////////////////////////////////////////////////////////////
+
+class DoubleRingQueue {
+ public:
+  // Constructor for a DoubleRingQueue.
+  // Initializes the queue to be empty with room for at least capacity
+  // values. The capacity is rounded up to a power of two.
+  explicit DoubleRingQueue(size_t capacity = 1024);
+
+  // Destructor for DoubleRingQueue.
+  ~DoubleRingQueue() = default;
+
+  // Adds a double to the end of the queue. If the queue is full, the calling
+  // thread blocks until there is room or the queue is closed.
+  // This operation is thread safe.
+  //
+  // Arguments:
+  // - val: the double value to add to the end of the queue
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed
+  bool add(double val);
+
+  // Closes the queue.
+  //
+  // Any calls to add() that happens after calling close should fail
+  // and return false, including calls blocked on a full queue.
+  //
+  // calls to remove() or wait_remove() should return nullopt
+  // if there are no elements in the queue left.
+  //
+  // Threads blocked on wait_remove() will be waken up to either
+  // process any values left in the queue or return nullopt
+  void close();
+
+  // Removes a double from the front of the queue
+  // This operation is thread safe.
+  //
+  // Arguments: None
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if there were no values in the queue
+  std::optional<double> remove();
+
+  // Removes a double from the front of the queue but if there is no double
+  // in the queue, calling thread will block until there is a double
+  // available. If the the queue is closed and the queue is empty, then it
+  // returns nullopt instead.
+  //
+  // This operation is thread safe.
+  //
+  // Arguments: None
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if the queue is closed and empty
+  std::optional<double> wait_remove();
+
+  // Returns the length of the queue currently
+  // This operation is thread safe.
+  //
+  // Arguments: None
+  //
+  // Returns:
+  // The value length of (i.e. number of elements in) the queue
+  int length();
+
+  // Returns the number of values the queue can hold
+  size_t capacity() const { return mask + 1; }
+
+  DoubleRingQueue(const DoubleRingQueue& other) = delete;
+  DoubleRingQueue& operator=(const DoubleRingQueue& other) = delete;
+  DoubleRingQueue(DoubleRingQueue&& other) = delete;
+  DoubleRingQueue& operator=(DoubleRingQueue&& other) = delete;
+
+ private:
+  // A slot of the ring. A slot at index i is free for the producer that
+  // claims position p = i + n * capacity when sequence == p, and holds a
+  // value for the consumer that claims position p when sequence == p + 1.
+  struct Slot {
+    std::atomic<size_t> sequence;
+    double value;
+  };
+
+  // The outcome of a single non-blocking attempt
+  enum class Attempt { kDone, kEmptyOrFull, kClosed };
+
+  // Set in the producer position once the queue is closed, so that no
+  // position can be claimed after close() returns
+  static constexpr size_t kClosedBit = size_t{1} << 63;
+
+  // Helper methods
+  Attempt try_add(double val);
+  Attempt try_remove(double& val);
+  bool closed_and_drained() const;
+  void notify(std::atomic<uint32_t>& epoch, const std::atomic<int>& waiters);
+
+  // Fields
+  // The positions are on their own cache lines so that producers and
+  // consumers do not invalidate each other's line on every operation
+  alignas(64) std::atomic<size_t> enqueuePos{0};
+  alignas(64) std::atomic<size_t> dequeuePos{0};
+
+  // Bumped to wake threads sleeping on an empty (items) or full (space) ring
+  alignas(64) std::atomic<uint32_t> itemsEpoch{0};
+  std::atomic<int> consumersWaiting{0};
+  alignas(64) std::atomic<uint32_t> spaceEpoch{0};
+  std::atomic<int> producersWaiting{0};
+
+  alignas(64) size_t mask;
+  std::unique_ptr<Slot[]> slots;
+};
+
+#endif  // DOUBLERINGQUEUE_HPP_
@@ -0,0 +1,203 @@
+#include "ImageQuality.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// The SSIM constants (k1 L)^2 and (k2 L)^2 for k1 = 0.01, k2 = 0.03 and a
+// dynamic range L of 255
+constexpr double kC1 = (0.01 * 255) * (0.01 * 255);
+constexpr double kC2 = (0.03 * 255) * (0.03 * 255);
+
+// One worker's totals, on a cache line of its own so that workers adding
+// to their totals do not slow each other down
+struct alignas(64) WorkerQuality {
+  uint64_t squared_error = 0;
+  int max_error = 0;
+  double ssim_sum = 0;
+};
+
+// The sums of the luma x of one image, the luma y of the other, and their
+// squares and products, per column over the rows of the current window
+struct ColumnSums {
+  explicit ColumnSums(UINT width)
+      : x(width), y(width), xx(width), yy(width), xy(width) {}
+  vector<int64_t> x, y, xx, yy, xy;
+};
+
+// Returns the luma of a pixel as an integer from 0 to 255, with the
+// BT.601 weights
+inline UCHAR luma(const UCHAR* p) {
+  return (77 * p[RowSpan::kRed] + 150 * p[RowSpan::kGreen] +
+          29 * p[RowSpan::kBlue] + 128) >> 8;
+}
+
+// Adds the squared and largest channel errors of the first width pixels of
+// two rows to totals
+void add_errors(const RowSpan& row1,
+                const RowSpan& row2,
+                UINT width,
+                WorkerQuality& totals) {
+  uint64_t squared = 0;
+  int largest = totals.max_error;
+  for (UINT x = 0; x < width; ++x) {
+    const UCHAR* p1 = row1.pixel(x);
+    const UCHAR* p2 = row2.pixel(x);
+    for (UINT c : {RowSpan::kBlue, RowSpan::kGreen, RowSpan::kRed}) {
+      int error = abs(p1[c] - p2[c]);
+      squared += error * error;
+      largest = max(largest, error);
+    }
+  }
+  totals.squared_error += squared;
+  totals.max_error = largest;
+}
+
+// Returns the SSIM of one window from its sums over count pixels. The
+// means, variances and covariance are all divided by count, so the terms
+// are scaled by count squared to keep the exact integer differences.
+inline double window_ssim(int64_t count,
+                          int64_t sx,
+                          int64_t sy,
+                          int64_t sxx,
+                          int64_t syy,
+                          int64_t sxy) {
+  const double scale = static_cast<double>(count) * count;
+  const double means = static_cast<double>(sx * sy);
+  const double variances =
+      static_cast<double>(count * sxx - sx * sx + count * syy - sy * sy);
+  const double covariance = static_cast<double>(count * sxy - sx * sy);
+  const double squares = static_cast<double>(sx * sx + sy * sy);
+  return ((2 * means + kC1 * scale) * (2 * covariance + kC2 * scale)) /
+         ((squares + kC1 * scale) * (variances + kC2 * scale));
+}
+
+// Returns the sum of the SSIM of every window whose top left corner is on
+// the row the column sums cover, sliding the window along the row
+double row_ssim_sum(const ColumnSums& cols, UINT width, UINT window) {
+  const int64_t count = static_cast<int64_t>(window) * window;
+  int64_t sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+  for (UINT x = 0; x < window; ++x) {
+    sx += cols.x[x];
+    sy += cols.y[x];
+    sxx += cols.xx[x];
+    syy += cols.yy[x];
+    sxy += cols.xy[x];
+  }
+  double sum = window_ssim(count, sx, sy, sxx, syy, sxy);
+  for (UINT x = window; x < width; ++x) {
+    const UINT old = x - window;
+    sx += cols.x[x] - cols.x[old];
+    sy += cols.y[x] - cols.y[old];
+    sxx += cols.xx[x] - cols.xx[old];
+    syy += cols.yy[x] - cols.yy[old];
+    sxy += cols.xy[x] - cols.xy[old];
+    sum += window_ssim(count, sx, sy, sxx, syy, sxy);
+  }
+  return sum;
+}
+
+// Adds (sign 1) or removes (sign -1) one row of luma to the column sums
+void slide_columns(ColumnSums& cols,
+                   const UCHAR* luma1,
+                   const UCHAR* luma2,
+                   UINT width,
+                   int sign) {
+  for (UINT x = 0; x < width; ++x) {
+    const int64_t a = luma1[x];
+    const int64_t b = luma2[x];
+    cols.x[x] += sign * a;
+    cols.y[x] += sign * b;
+    cols.xx[x] += sign * a * a;
+    cols.yy[x] += sign * b * b;
+    cols.xy[x] += sign * a * b;
+  }
+}
+
+}  // namespace
+
+QualityMetrics measure_quality(BitMap& bmp1,
+                               BitMap& bmp2,
+                               ThreadPool& pool,
+                               UINT window) {
+  const UINT width = min(bmp1.width(), bmp2.width());
+  const UINT height = min(bmp1.height(), bmp2.height());
+  QualityMetrics metrics;
+  if (width == 0 || height == 0) {
+    metrics.psnr = numeric_limits<double>::infinity();
+    return metrics;
+  }
+  window = min<UINT>({clamp<UINT>(window, 1, kMaxSsimWindow), width, height});
+
+  // Each chunk measures the windows whose top row is in [top_begin,
+  // top_end), reading the window - 1 rows below the chunk too, and counts
+  // the channel errors of its own rows, plus those of the rows below the
+  // last window for the last chunk
+  const UINT top_rows = height - window + 1;
+  const UINT left_columns = width - window + 1;
+  vector<WorkerQuality> partials(pool.size());
+  const size_t grain =
+      max<size_t>(8 * window, top_rows / (4 * static_cast<size_t>(pool.size())));
+  pool.parallel_for(0, top_rows, grain, [&](size_t top_begin, size_t top_end) {
+    WorkerQuality section;
+    ColumnSums cols(width);
+    // The luma of the rows in the window; row y is at y % window
+    vector<UCHAR> luma1(static_cast<size_t>(window) * width);
+    vector<UCHAR> luma2(luma1.size());
+
+    auto add_row = [&](UINT y) {
+      RowSpan row1 = bmp1.row(y);
+      RowSpan row2 = bmp2.row(y);
+      UCHAR* l1 = &luma1[static_cast<size_t>(y % window) * width];
+      UCHAR* l2 = &luma2[static_cast<size_t>(y % window) * width];
+      for (UINT x = 0; x < width; ++x) {
+        l1[x] = luma(row1.pixel(x));
+        l2[x] = luma(row2.pixel(x));
+      }
+      slide_columns(cols, l1, l2, width, 1);
+      if (y < top_end || top_end == top_rows) {
+        add_errors(row1, row2, width, section);
+      }
+    };
+    auto remove_row = [&](UINT y) {
+      size_t offset = static_cast<size_t>(y % window) * width;
+      slide_columns(cols, &luma1[offset], &luma2[offset], width, -1);
+    };
+
+    for (UINT y = top_begin; y < top_begin + window - 1; ++y) {
+      add_row(y);
+    }
+    for (UINT top = top_begin; top < top_end; ++top) {
+      add_row(top + window - 1);
+      section.ssim_sum += row_ssim_sum(cols, width, window);
+      remove_row(top);
+    }
+
+    WorkerQuality& totals = partials[ThreadPool::current_worker()];
+    totals.squared_error += section.squared_error;
+    totals.max_error = max(totals.max_error, section.max_error);
+    totals.ssim_sum += section.ssim_sum;
+  });
+
+  uint64_t squared_error = 0;
+  double ssim_sum = 0;
+  for (const WorkerQuality& partial : partials) {
+    squared_error += partial.squared_error;
+    metrics.max_error = max(metrics.max_error, partial.max_error);
+    ssim_sum += partial.ssim_sum;
+  }
+  metrics.mse = static_cast<double>(squared_error) /
+                (3.0 * static_cast<double>(width) * height);
+  metrics.psnr = metrics.mse == 0
+                     ? numeric_limits<double>::infinity()
+                     : 10 * log10(255.0 * 255.0 / metrics.mse);
+  metrics.ssim =
+      ssim_sum / (static_cast<double>(top_rows) * left_columns);
+  return metrics;
+}
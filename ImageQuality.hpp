@@ -0,0 +1,53 @@
+#ifndef IMAGEQUALITY_HPP_
+#define IMAGEQUALITY_HPP_
+
+#include "ThreadPool.hpp"
+#include "qdbmp.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Quality metrics of an image against a reference, for judging how far an
+// approximate filter is from the exact one.
+//
+// MSE, PSNR and the largest error are taken over the red, green and blue
+// channels. SSIM is the mean structural similarity of the luma over every
+// window x window square of pixels, with the constants of Wang et al.
+// Each window's sums come from per-column sums over the last window rows,
+// updated by adding the newest row and removing the oldest, and a running
+// sum along the row, so SSIM costs the same per pixel whatever the window
+// size. Luma is kept as an integer, so the sums are exact however long
+// they are slid. Bands of rows are measured on the workers of a
+// ThreadPool.
+///////////////////////////////////////////////////////////////////////////////
+
+// The SSIM window used unless another is asked for
+constexpr UINT kDefaultSsimWindow = 8;
+// The largest SSIM window
+constexpr UINT kMaxSsimWindow = 1024;
+
+// How much one image differs from another
+struct QualityMetrics {
+  double mse = 0;     // mean squared red, green and blue difference
+  double psnr = 0;    // peak signal to noise ratio in dB, infinite if mse is 0
+  int max_error = 0;  // largest absolute red, green or blue difference
+  double ssim = 1;    // mean SSIM of the luma, 1 for identical images
+};
+
+// Measures bmp1 against bmp2 over the pixels both images have: the top
+// left min(width) x min(height) pixels. Alpha bytes are ignored. Images
+// smaller than the window in either direction are measured with a window
+// as large as the image allows.
+//
+// Arguments:
+// - bmp1, bmp2: the images to measure
+// - pool: the workers to split the rows between
+// - window: the side of the SSIM window in pixels, from 1 to
+//   kMaxSsimWindow, past which the exact sums could overflow
+//
+// Returns:
+// - the metrics, or those of identical images if the images share no pixel
+QualityMetrics measure_quality(BitMap& bmp1,
+                               BitMap& bmp2,
+                               ThreadPool& pool,
+                               UINT window = kDefaultSsimWindow);
+
+#endif  // IMAGEQUALITY_HPP_
@@ -0,0 +1,69 @@
+#include "NumberParsing.hpp"
+#include <cctype>
+#include <cerrno>
+#include <charconv>  // For from_chars
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+// Parses the line with strtod, the way stod does, for the numbers whose
+// range from_chars does not judge as stod would. strtod needs a
+// terminated string and would skip the end of an empty line, so it gets
+// a copy of the line.
+optional<double> parseWithStrtod(const char* first, const char* last) {
+  thread_local string copy;
+  copy.assign(first, last);
+  char* end;
+  errno = 0;
+  double num = strtod(copy.c_str(), &end);
+  if (end == copy.c_str() || errno == ERANGE) {
+    return nullopt;
+  }
+  return num;
+}
+
+}  // namespace
+
+optional<double> parseLine(const char* first, const char* last) {
+  const char* line = first;
+  while (first != last && isspace(static_cast<unsigned char>(*first))) {
+    ++first;
+  }
+  bool negative = false;
+  if (first != last && (*first == '+' || *first == '-')) {
+    negative = *first == '-';
+    ++first;
+    if (first != last && (*first == '+' || *first == '-')) {
+      return nullopt;  // from_chars would accept the second sign
+    }
+  }
+  chars_format format = chars_format::general;
+  if (last - first >= 2 && first[0] == '0' &&
+      (first[1] == 'x' || first[1] == 'X')) {
+    format = chars_format::hex;
+    first += 2;
+    if (first != last && (*first == '+' || *first == '-')) {
+      // from_chars would read a sign after the prefix; stod stops at the x
+      // and reads 0
+      return negative ? -0.0 : 0.0;
+    }
+  }
+  double num;
+  from_chars_result result = from_chars(first, last, num, format);
+  if (result.ec == errc::invalid_argument && format == chars_format::hex) {
+    num = 0.0;  // stod reads "0x" with no hex digits after it as 0
+  } else if (result.ec == errc::invalid_argument) {
+    return nullopt;
+  } else if (result.ec != errc() || num == 0.0 ||
+             fpclassify(num) == FP_SUBNORMAL) {
+    // stod rejects numbers that underflow, except zeros and subnormals it
+    // can represent exactly, and from_chars tells neither apart
+    return parseWithStrtod(line, last);
+  }
+  return negative ? -num : num;
+}
@@ -0,0 +1,30 @@
+#ifndef NUMBERPARSING_HPP_
+#define NUMBERPARSING_HPP_
+
+#include <optional>
+
+///////////////////////////////////////////////////////////////////////////////
+// Parsing of the numbers read by the numbers program, one per line.
+//
+// parseLine() gives the same answers as stod, which the program used to
+// call on every line, but with from_chars, which does not allocate, throw
+// or consult the locale. The few numbers whose range from_chars judges
+// differently from stod, the ones that come out as 0 or subnormal, are
+// parsed again with strtod, which is what stod calls.
+///////////////////////////////////////////////////////////////////////////////
+
+// Parses the number at the start of the line [first, last) the way stod
+// does: leading whitespace and one sign are allowed, hexadecimal needs a
+// 0x prefix, and anything after the number is ignored.
+//
+// Arguments:
+// - first, last: the line, without its end of line
+//
+// Returns:
+// - the number
+// - nullopt if the line does not start with a number, or the number is out
+//   of the range of a double, including numbers too small to be a normal
+//   double that are not exactly a subnormal one
+std::optional<double> parseLine(const char* first, const char* last);
+
+#endif  // NUMBERPARSING_HPP_
@@ -0,0 +1,272 @@
+#include "PixelKernels.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Replaces each of the size bytes of data with its complement ANDed with a
+// repeating 4 byte mask: byte i is masked with byte (i % 4) of mask,
+// counting from its least significant byte.
+using InvertKernel = void (*)(UCHAR* data, size_t size, uint32_t mask);
+
+// Flips blue, green and red of a 32 BPP pixel and clears its alpha
+constexpr uint32_t kInvertMask32 = 0x00FFFFFF;
+
+// A 24 BPP row holds only color bytes, so all of them are flipped
+constexpr uint32_t kInvertMask24 = 0xFFFFFFFF;
+
+// Compares pixels pixels of a and b, both bytes_per_pixel (3 or 4) bytes
+// per pixel, and adds the differences and matches to result
+using CompareKernel = void (*)(const UCHAR* a,
+                               const UCHAR* b,
+                               size_t pixels,
+                               UINT bytes_per_pixel,
+                               RowComparison& result);
+
+void invert_scalar(UCHAR* data, size_t size, uint32_t mask) {
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = ~data[i] & static_cast<UCHAR>(mask >> (8 * (i % 4)));
+  }
+}
+
+// Compares pixels with any pixel sizes, one channel at a time
+void compare_scalar_mixed(const UCHAR* a,
+                          UINT a_bpp,
+                          const UCHAR* b,
+                          UINT b_bpp,
+                          size_t pixels,
+                          RowComparison& result) {
+  for (size_t x = 0; x < pixels; ++x, a += a_bpp, b += b_bpp) {
+    int dr = abs(a[RowSpan::kRed] - b[RowSpan::kRed]);
+    int dg = abs(a[RowSpan::kGreen] - b[RowSpan::kGreen]);
+    int db = abs(a[RowSpan::kBlue] - b[RowSpan::kBlue]);
+    result.diff += dr + dg + db;
+    result.matching += (dr | dg | db) == 0;
+  }
+}
+
+void compare_scalar(const UCHAR* a,
+                    const UCHAR* b,
+                    size_t pixels,
+                    UINT bytes_per_pixel,
+                    RowComparison& result) {
+  compare_scalar_mixed(a, bytes_per_pixel, b, bytes_per_pixel, pixels,
+                       result);
+}
+
+#if defined(__x86_64__)
+
+// SSE2 is part of x86-64, so this version needs no CPU check
+void invert_sse2(UCHAR* data, size_t size, uint32_t mask) {
+  const __m128i pattern = _mm_set1_epi32(static_cast<int>(mask));
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    __m128i* chunk = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(chunk,
+                     _mm_andnot_si128(_mm_loadu_si128(chunk), pattern));
+  }
+  // i is a multiple of 4, so the mask stays lined up with the pixels
+  invert_scalar(data + i, size - i, mask);
+}
+
+// Bit i * 3 set for each of the 16 pixels whose channels fill a 48 bit
+// byte-equality mask of 24 BPP pixels
+constexpr uint64_t kFirstChannelBits = 0x249249249249;
+
+// Returns how many of the 16 pixels of a 48 bit byte-equality mask of
+// 24 BPP pixels have all three bytes equal
+inline UINT count_matching24(uint64_t equal) {
+  return std::popcount(equal & (equal >> 1) & (equal >> 2) &
+                       kFirstChannelBits);
+}
+
+// Sums the absolute differences of a and b with psadbw, which adds the
+// differences of each 8 bytes into a 64 bit lane, and counts matching
+// pixels from byte-equality masks. 32 BPP pixels have their alpha masked
+// off first.
+void compare_sse2(const UCHAR* a,
+                  const UCHAR* b,
+                  size_t pixels,
+                  UINT bytes_per_pixel,
+                  RowComparison& result) {
+  __m128i sums = _mm_setzero_si128();
+  size_t x = 0;
+  if (bytes_per_pixel == 4) {
+    const __m128i colors = _mm_set1_epi32(0x00FFFFFF);
+    for (; x + 4 <= pixels; x += 4) {
+      __m128i pa = _mm_and_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 4)),
+          colors);
+      __m128i pb = _mm_and_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 4)),
+          colors);
+      sums = _mm_add_epi64(sums, _mm_sad_epu8(pa, pb));
+      // One all-ones 32 bit lane, so 4 mask bits, per matching pixel
+      int equal = _mm_movemask_epi8(_mm_cmpeq_epi32(pa, pb));
+      result.matching += std::popcount(static_cast<unsigned>(equal)) / 4;
+    }
+  } else {
+    for (; x + 16 <= pixels; x += 16) {
+      const __m128i* va = reinterpret_cast<const __m128i*>(a + x * 3);
+      const __m128i* vb = reinterpret_cast<const __m128i*>(b + x * 3);
+      uint64_t equal = 0;
+      for (int i = 0; i < 3; ++i) {
+        __m128i pa = _mm_loadu_si128(va + i);
+        __m128i pb = _mm_loadu_si128(vb + i);
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(pa, pb));
+        equal |= static_cast<uint64_t>(static_cast<unsigned>(
+                     _mm_movemask_epi8(_mm_cmpeq_epi8(pa, pb))))
+                 << (16 * i);
+      }
+      result.matching += count_matching24(equal);
+    }
+  }
+  result.diff += static_cast<uint64_t>(_mm_cvtsi128_si64(sums)) +
+                 static_cast<uint64_t>(
+                     _mm_cvtsi128_si64(_mm_unpackhi_epi64(sums, sums)));
+  compare_scalar(a + x * bytes_per_pixel, b + x * bytes_per_pixel,
+                 pixels - x, bytes_per_pixel, result);
+}
+
+__attribute__((target("avx2"))) void compare_avx2(const UCHAR* a,
+                                                  const UCHAR* b,
+                                                  size_t pixels,
+                                                  UINT bytes_per_pixel,
+                                                  RowComparison& result) {
+  __m256i sums = _mm256_setzero_si256();
+  size_t x = 0;
+  if (bytes_per_pixel == 4) {
+    const __m256i colors = _mm256_set1_epi32(0x00FFFFFF);
+    for (; x + 8 <= pixels; x += 8) {
+      __m256i pa = _mm256_and_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x * 4)),
+          colors);
+      __m256i pb = _mm256_and_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x * 4)),
+          colors);
+      sums = _mm256_add_epi64(sums, _mm256_sad_epu8(pa, pb));
+      int equal = _mm256_movemask_epi8(_mm256_cmpeq_epi32(pa, pb));
+      result.matching += std::popcount(static_cast<unsigned>(equal)) / 4;
+    }
+  } else {
+    // 32 pixels are 96 bytes: three 32 byte masks, split into two 48 bit
+    // masks of 16 pixels each
+    for (; x + 32 <= pixels; x += 32) {
+      const __m256i* va = reinterpret_cast<const __m256i*>(a + x * 3);
+      const __m256i* vb = reinterpret_cast<const __m256i*>(b + x * 3);
+      uint64_t masks[3];
+      for (int i = 0; i < 3; ++i) {
+        __m256i pa = _mm256_loadu_si256(va + i);
+        __m256i pb = _mm256_loadu_si256(vb + i);
+        sums = _mm256_add_epi64(sums, _mm256_sad_epu8(pa, pb));
+        masks[i] = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(pa, pb)));
+      }
+      result.matching +=
+          count_matching24(masks[0] | (masks[1] & 0xFFFF) << 32) +
+          count_matching24(masks[1] >> 16 | masks[2] << 16);
+    }
+  }
+  __m128i halves = _mm_add_epi64(_mm256_castsi256_si128(sums),
+                                 _mm256_extracti128_si256(sums, 1));
+  result.diff += static_cast<uint64_t>(_mm_cvtsi128_si64(halves)) +
+                 static_cast<uint64_t>(
+                     _mm_cvtsi128_si64(_mm_unpackhi_epi64(halves, halves)));
+  compare_sse2(a + x * bytes_per_pixel, b + x * bytes_per_pixel, pixels - x,
+               bytes_per_pixel, result);
+}
+
+__attribute__((target("avx2"))) void invert_avx2(UCHAR* data,
+                                                 size_t size,
+                                                 uint32_t mask) {
+  const __m256i pattern = _mm256_set1_epi32(static_cast<int>(mask));
+  size_t i = 0;
+  // Two independent 32 byte chunks per iteration keep both load ports busy
+  for (; i + 64 <= size; i += 64) {
+    __m256i* chunk = reinterpret_cast<__m256i*>(data + i);
+    __m256i first = _mm256_loadu_si256(chunk);
+    __m256i second = _mm256_loadu_si256(chunk + 1);
+    _mm256_storeu_si256(chunk, _mm256_andnot_si256(first, pattern));
+    _mm256_storeu_si256(chunk + 1, _mm256_andnot_si256(second, pattern));
+  }
+  for (; i + 32 <= size; i += 32) {
+    __m256i* chunk = reinterpret_cast<__m256i*>(data + i);
+    _mm256_storeu_si256(
+        chunk, _mm256_andnot_si256(_mm256_loadu_si256(chunk), pattern));
+  }
+  invert_sse2(data + i, size - i, mask);
+}
+
+#endif
+
+// The kernels picked for this CPU
+struct Dispatch {
+  InvertKernel invert;
+  CompareKernel compare;
+  const char* isa;
+};
+
+// Picks the fastest supported version, or a slower one named by requested,
+// the PIXEL_KERNELS_ISA environment variable unless a test names one, to
+// compare or test the versions
+Dispatch select_kernels(const char* requested) {
+  string isa = requested != nullptr ? requested : "";
+  if (isa == "scalar") {
+    return Dispatch{invert_scalar, compare_scalar, "scalar"};
+  }
+#if defined(__x86_64__)
+  if (isa != "sse2" && __builtin_cpu_supports("avx2")) {
+    return Dispatch{invert_avx2, compare_avx2, "avx2"};
+  }
+  return Dispatch{invert_sse2, compare_sse2, "sse2"};
+#else
+  return Dispatch{invert_scalar, compare_scalar, "scalar"};
+#endif
+}
+
+Dispatch& kernels() {
+  static Dispatch selected = select_kernels(getenv("PIXEL_KERNELS_ISA"));
+  return selected;
+}
+
+}  // namespace
+
+void invert_row(const RowSpan& row) {
+  const uint32_t mask =
+      row.bytes_per_pixel == 4 ? kInvertMask32 : kInvertMask24;
+  kernels().invert(row.data, row.size_bytes(), mask);
+}
+
+RowComparison compare_rows(const RowSpan& row1,
+                           const RowSpan& row2,
+                           UINT width) {
+  RowComparison result{0, 0};
+  if (row1.bytes_per_pixel == row2.bytes_per_pixel) {
+    kernels().compare(row1.data, row2.data, width, row1.bytes_per_pixel,
+                      result);
+  } else {
+    compare_scalar_mixed(row1.data, row1.bytes_per_pixel, row2.data,
+                         row2.bytes_per_pixel, width, result);
+  }
+  return result;
+}
+
+const char* pixel_kernels_isa() {
+  return kernels().isa;
+}
+
+const char* select_pixel_kernels(const char* isa) {
+  kernels() = select_kernels(isa != nullptr ? isa
+                                            : getenv("PIXEL_KERNELS_ISA"));
+  return kernels().isa;
+}
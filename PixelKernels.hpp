@@ -0,0 +1,50 @@
+#ifndef PIXELKERNELS_HPP_
+#define PIXELKERNELS_HPP_
+
+#include <cstdint>
+#include "qdbmp.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-row pixel kernels that work on the raw bytes of a RowSpan.
+//
+// Each kernel has an AVX2, an SSE2 and a plain C++ version. The fastest
+// version the CPU supports is picked the first time a kernel is called, so
+// the same binary runs on any x86-64 machine, and other architectures use
+// the plain version. Setting the PIXEL_KERNELS_ISA environment variable to
+// "sse2" or "scalar" forces a slower version.
+///////////////////////////////////////////////////////////////////////////////
+
+// Turns every pixel of row into its negative in place: red, green and blue
+// become 255 minus their value. The alpha byte of 32 BPP pixels is cleared,
+// as in a newly created BitMap, and the padding at the end of the row is left
+// untouched.
+void invert_row(const RowSpan& row);
+
+// What compare_rows() found in two rows
+struct RowComparison {
+  uint64_t diff;  // sum of the absolute red, green and blue differences
+  UINT matching;  // pixels whose red, green and blue all match
+};
+
+// Compares the first width pixels of row1 and row2, which both need at
+// least width pixels. Alpha bytes are ignored. The rows may have different
+// pixel sizes, though only rows of the same size use the SIMD versions.
+RowComparison compare_rows(const RowSpan& row1,
+                           const RowSpan& row2,
+                           UINT width);
+
+// Returns the instruction set the kernels run with on this CPU:
+// "avx2", "sse2" or "scalar".
+const char* pixel_kernels_isa();
+
+// Picks the kernels again, as if the PIXEL_KERNELS_ISA environment variable
+// were isa, or reads the variable again if isa is nullptr, so that tests
+// and benchmarks can run every version in one process. Not thread safe:
+// no kernel may run during the call.
+//
+// Returns:
+// - the instruction set the kernels now run with, which is isa unless the
+//   CPU does not support it
+const char* select_pixel_kernels(const char* isa);
+
+#endif  // PIXELKERNELS_HPP_
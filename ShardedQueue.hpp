@@ -0,0 +1,317 @@
+#ifndef SHARDEDQUEUE_HPP_
+#define SHARDEDQUEUE_HPP_
+
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+#include "ConcurrentQueue.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// A ShardedQueue<T> is a queue of T values split into several lanes, each
+// of which is a ConcurrentQueue<T> with its own lock, so that many
+// producers adding at once do not all contend on one mutex.
+//
+// Each producer adds to one lane, picked either by thread or by the CPU
+// the thread is running on. In kPerThread mode, each queue hands its lanes
+// out in turn to the threads that add to it, the first time they add.
+// Consumers try the lanes in turn, starting one lane after the one they
+// last removed from, and so take values from every lane. Values from one
+// lane come out in the order they were added, but there is no order
+// between lanes: in kPerThread mode, the values of any one producer keep
+// their order, but values of different producers may be removed in any
+// order. A ShardedQueue with a single lane is a strictly FIFO queue.
+//
+// Consumers that find every lane empty sleep on a shared condition
+// variable, which producers only signal when somebody is sleeping.
+// The queue is thread safe, with no potential for data races, or deadlocks
+///////////////////////////////////////////////////////////////////////////////
+
+// How a ShardedQueue picks the lane a producer adds to
+enum class LaneSelection {
+  kPerThread,  // each thread always adds to the same lane
+  kPerCpu,     // threads add to the lane of the CPU they are running on
+};
+
+template <typename T>
+class ShardedQueue {
+ public:
+  // Constructor for a ShardedQueue.
+  // Initializes every lane to be empty
+  //
+  // Arguments:
+  // - lanes: the number of lanes, at least 1
+  // - selection: how producers pick their lane
+  explicit ShardedQueue(size_t lanes,
+                        LaneSelection selection = LaneSelection::kPerThread);
+
+  // Destructor for ShardedQueue.
+  // Destroys any remaining values in the lanes
+  ~ShardedQueue();
+
+  ShardedQueue(const ShardedQueue&) = delete;
+  ShardedQueue& operator=(const ShardedQueue&) = delete;
+
+  // Adds a value to the end of the calling thread's lane
+  // This operation is thread safe.
+  //
+  // Arguments:
+  // - val: the value to add. It is moved into the queue if it is an rvalue.
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed
+  bool add(const T& val) { return emplace(val); }
+  bool add(T&& val) { return emplace(std::move(val)); }
+
+  // Constructs a value in place at the end of the calling thread's lane
+  // This operation is thread safe.
+  //
+  // Arguments:
+  // - args: the arguments to pass to the constructor of T
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed
+  template <typename... Args>
+  bool emplace(Args&&... args);
+
+  // Closes the queue: values can no longer be added, and consumers waiting
+  // on an empty queue are woken up. Values already in the lanes can still
+  // be removed.
+  // This operation is thread safe.
+  void close();
+
+  // Removes a value from the front of one of the lanes, if any lane has one
+  // This operation is thread safe.
+  //
+  // Returns:
+  // - an optional containing the removed value
+  // - an empty optional if every lane is empty
+  std::optional<T> try_remove();
+
+  // Removes a value from the front of one of the lanes, waiting for a value
+  // to be added if every lane is empty
+  // This operation is thread safe.
+  //
+  // Returns:
+  // - an optional containing the removed value
+  // - an empty optional once the queue is closed and every lane is empty
+  std::optional<T> wait_remove();
+
+  // Returns the number of values in all lanes together
+  // This operation is thread safe.
+  int length() const {
+    long count = pending.load();
+    return count > 0 ? static_cast<int>(count) : 0;
+  }
+
+  // Returns the number of lanes
+  size_t lane_count() const { return laneCount; }
+
+ private:
+  // A lane on cache lines of its own, so that producers adding to
+  // neighbouring lanes do not slow each other down
+  struct alignas(64) Lane {
+    ConcurrentQueue<T> queue;
+  };
+
+  size_t pickLane();
+  size_t producerLane();
+  std::optional<T> removeFromLanes();
+
+  std::unique_ptr<Lane[]> lanes;
+  size_t laneCount;
+  LaneSelection laneSelection;
+  unsigned long long queueId;  // unique to this queue, for producerLane()
+
+  // The producers this queue has seen, by sharded_queue_thread_token(), in
+  // the order they first added. Slots are claimed once and never freed, and
+  // producers that find every slot taken share lanes by token instead.
+  static constexpr size_t kProducerSlots = 64;
+  std::unique_ptr<std::atomic<unsigned long long>[]> producers;
+
+  // Values in the lanes. It goes up after a value is added to a lane and
+  // down after one is removed, so a consumer that sees it at 0 may sleep.
+  // A consumer may take a value before its producer raises pending, so it
+  // can briefly be negative.
+  alignas(64) std::atomic<long> pending;
+  std::atomic<int> sleepers;  // consumers blocked in wait_remove()
+  bool isClosed;              // guarded by mutex
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// ShardedQueue implementation
+///////////////////////////////////////////////////////////////////////////////
+
+// Returns a number unique to each ShardedQueue, whatever its T, so that
+// a queue never picks up lanes cached for a destroyed queue at its address
+inline unsigned long long sharded_queue_next_id() {
+  static std::atomic<unsigned long long> nextId{1};
+  return nextId.fetch_add(1);
+}
+
+// Returns a number unique to the calling thread, never 0
+inline unsigned long long sharded_queue_thread_token() {
+  static std::atomic<unsigned long long> nextToken{1};
+  thread_local unsigned long long token = nextToken.fetch_add(1);
+  return token;
+}
+
+// Returns the lane a consumer thread starts from the first time it removes,
+// handed out in turn so that consumers start on different lanes
+inline size_t sharded_queue_consumer_start() {
+  static std::atomic<size_t> nextStart{0};
+  return nextStart.fetch_add(1);
+}
+
+template <typename T>
+ShardedQueue<T>::ShardedQueue(size_t lanes, LaneSelection selection)
+    : lanes(std::make_unique<Lane[]>(lanes == 0 ? 1 : lanes)),
+      laneCount(lanes == 0 ? 1 : lanes),
+      laneSelection(selection),
+      queueId(sharded_queue_next_id()),
+      producers(std::make_unique<std::atomic<unsigned long long>[]>(
+          kProducerSlots)),
+      pending(0),
+      sleepers(0),
+      isClosed(false) {
+  pthread_mutex_init(&mutex, nullptr);
+  pthread_cond_init(&cond, nullptr);
+}
+
+template <typename T>
+ShardedQueue<T>::~ShardedQueue() {
+  pthread_mutex_destroy(&mutex);
+  pthread_cond_destroy(&cond);
+}
+
+// Adds a value to the calling thread's lane and wakes a sleeping consumer
+template <typename T>
+template <typename... Args>
+bool ShardedQueue<T>::emplace(Args&&... args) {
+  if (!lanes[pickLane()].queue.emplace(std::forward<Args>(args)...)) {
+    return false;
+  }
+  // A consumer counts itself as a sleeper before it checks pending, both
+  // under the mutex, and this thread raises pending before it checks the
+  // sleepers, so either the consumer sees the value or it is signalled
+  pending.fetch_add(1);
+  if (sleepers.load() > 0) {
+    pthread_mutex_lock(&mutex);
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+  }
+  return true;
+}
+
+// Closes every lane and wakes every sleeping consumer
+template <typename T>
+void ShardedQueue<T>::close() {
+  pthread_mutex_lock(&mutex);
+  isClosed = true;
+  for (size_t i = 0; i < laneCount; ++i) {
+    lanes[i].queue.close();
+  }
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+// Removes a value from one of the lanes without waiting
+template <typename T>
+std::optional<T> ShardedQueue<T>::try_remove() {
+  if (pending.load() <= 0) {
+    return std::nullopt;  // Don't bother locking every lane
+  }
+  return removeFromLanes();
+}
+
+// Removes a value from one of the lanes, sleeping while all are empty
+template <typename T>
+std::optional<T> ShardedQueue<T>::wait_remove() {
+  while (true) {
+    if (std::optional<T> val = try_remove()) {
+      return val;
+    }
+    pthread_mutex_lock(&mutex);
+    sleepers.fetch_add(1);
+    while (pending.load() <= 0 && !isClosed) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+    sleepers.fetch_sub(1);
+    bool closed = isClosed;
+    pthread_mutex_unlock(&mutex);
+    if (closed) {
+      // No value can be added any more, but one may have reached its lane
+      // before its producer raised pending, so look in every lane once
+      return removeFromLanes();
+    }
+    // A value was added, but another consumer may take it first; in that
+    // case try again
+  }
+}
+
+// Private method: returns the lane the calling thread adds to
+template <typename T>
+size_t ShardedQueue<T>::pickLane() {
+  if (laneSelection == LaneSelection::kPerCpu) {
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+      return static_cast<size_t>(cpu) % laneCount;
+    }
+  }
+  return producerLane();
+}
+
+// Private method: returns the lane this queue gave the calling thread,
+// claiming the next free producer slot if it never added to this queue
+// before: the n-th producer gets lane n % laneCount. The lane of the last
+// queue the thread added to is kept aside, so a producer only looks
+// through the slots when it moves between queues.
+template <typename T>
+size_t ShardedQueue<T>::producerLane() {
+  thread_local unsigned long long lastQueue = 0;
+  thread_local size_t lastLane = 0;
+  if (lastQueue == queueId) {
+    return lastLane;
+  }
+  const unsigned long long token = sharded_queue_thread_token();
+  size_t lane = token % laneCount;  // if every slot is taken
+  for (size_t slot = 0; slot < kProducerSlots; ++slot) {
+    unsigned long long owner = producers[slot].load();
+    if (owner == 0 && producers[slot].compare_exchange_strong(owner, token)) {
+      owner = token;
+    }
+    if (owner == token) {
+      lane = slot % laneCount;
+      break;
+    }
+  }
+  lastQueue = queueId;
+  lastLane = lane;
+  return lane;
+}
+
+// Private method: removes a value from the first lane that has one,
+// starting one lane after where the calling thread last found a value
+template <typename T>
+std::optional<T> ShardedQueue<T>::removeFromLanes() {
+  // Only a hint of where to start, shared by every queue of T
+  thread_local size_t nextLane = sharded_queue_consumer_start();
+  for (size_t tried = 0; tried < laneCount; ++tried) {
+    size_t lane = (nextLane + tried) % laneCount;
+    if (std::optional<T> val = lanes[lane].queue.try_remove()) {
+      pending.fetch_sub(1);
+      nextLane = lane + 1;
+      return val;
+    }
+  }
+  return std::nullopt;
+}
+
+#endif  // SHARDEDQUEUE_HPP_
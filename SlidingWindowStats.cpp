@@ -0,0 +1,191 @@
+/* Sliding window minimum, maximum and mean over a ring of values, with
+   monotonic queues for the extremes and a compensated running sum. */
+
+#include "SlidingWindowStats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+SlidingWindowStats::SlidingWindowStats(size_t window)
+    : values(std::max<size_t>(window, 1)),
+      count(0),
+      nextSeq(0),
+      minQueue(values.size()),
+      maxQueue(values.size()),
+      finiteSum(0.0),
+      compensation(0.0),
+      sumOverflowed(false),
+      positiveInfinities(values.size()),
+      negativeInfinities(values.size()),
+      nans(values.size()) {}
+
+// Adds a value, evicting the oldest one if the window is full
+void SlidingWindowStats::add(double val) {
+  if (count == values.size()) {
+    evict(nextSeq - count);
+  } else {
+    count++;
+  }
+  const uint64_t seq = nextSeq++;
+  values[seq % values.size()] = val;
+
+  if (isnan(val)) {
+    nans.push_back(seq);  // Neither a minimum nor a maximum candidate
+  } else {
+    // A candidate only stays while no later value beats it; ties keep the
+    // older value in front
+    while (!minQueue.empty() && val < valueOf(minQueue.back())) {
+      minQueue.pop_back();
+    }
+    minQueue.push_back(seq);
+    while (!maxQueue.empty() && valueOf(maxQueue.back()) < val) {
+      maxQueue.pop_back();
+    }
+    maxQueue.push_back(seq);
+
+    if (isinf(val)) {
+      (val > 0 ? positiveInfinities : negativeInfinities).push_back(seq);
+    } else {
+      addToSum(val);
+    }
+  }
+  // An overflowed sum cannot take the evicted value back out, so it is
+  // summed again from the window until it fits in a double
+  if (sumOverflowed) {
+    resum();
+  }
+}
+
+// Empties the window
+void SlidingWindowStats::clear() {
+  count = 0;
+  minQueue.clear();
+  maxQueue.clear();
+  finiteSum = compensation = 0.0;
+  sumOverflowed = false;
+  positiveInfinities.clear();
+  negativeInfinities.clear();
+  nans.clear();
+}
+
+// Returns the i-th oldest value
+double SlidingWindowStats::at(size_t i) const {
+  return valueOf(nextSeq - count + i);
+}
+
+// Returns the oldest of the smallest values, or the oldest value if it is
+// NaN. A window whose oldest value is not NaN has a candidate.
+double SlidingWindowStats::min() const {
+  const double oldest = at(0);
+  return isnan(oldest) ? oldest : valueOf(minQueue.front());
+}
+
+// Returns the oldest of the largest values, or the oldest value if it is
+// NaN
+double SlidingWindowStats::max() const {
+  const double oldest = at(0);
+  return isnan(oldest) ? oldest : valueOf(maxQueue.front());
+}
+
+// Returns the sum of the window, following the IEEE rules for adding
+// infinities and NaN. Which NaN an addition of two keeps is up to the
+// compiler and hardware; this is the first NaN met adding up oldest first,
+// as an optimized accumulate does on x86: the oldest NaN value, or the NaN
+// the hardware makes of adding opposite infinities once both have been
+// met, whichever comes first.
+double SlidingWindowStats::sum() const {
+  const bool bothInfinities =
+      !positiveInfinities.empty() && !negativeInfinities.empty();
+  if (bothInfinities) {
+    const uint64_t opposed =
+        std::max(positiveInfinities.front(), negativeInfinities.front());
+    if (nans.empty() || opposed < nans.front()) {
+      return valueOf(positiveInfinities.front()) +
+             valueOf(negativeInfinities.front());
+    }
+  }
+  if (!nans.empty()) {
+    return valueOf(nans.front());
+  }
+  // The finite values may have overflowed to an infinity of their own
+  const double finite = finiteSum + compensation;
+  if (!positiveInfinities.empty()) {
+    return numeric_limits<double>::infinity() + finite;
+  }
+  if (!negativeInfinities.empty()) {
+    return -numeric_limits<double>::infinity() + finite;
+  }
+  return finite;
+}
+
+// Private method: removes the value with sequence number seq, the oldest
+// one in the window, from the queues and the sum
+void SlidingWindowStats::evict(uint64_t seq) {
+  const double val = valueOf(seq);
+  if (!minQueue.empty() && minQueue.front() == seq) {
+    minQueue.pop_front();
+  }
+  if (!maxQueue.empty() && maxQueue.front() == seq) {
+    maxQueue.pop_front();
+  }
+  // The oldest value is at the front of whichever queue holds it
+  if (isnan(val)) {
+    nans.pop_front();
+  } else if (isinf(val)) {
+    (val > 0 ? positiveInfinities : negativeInfinities).pop_front();
+  } else {
+    addToSum(-val);
+  }
+}
+
+// Private method: adds val to the running sum, keeping the low-order bits
+// lost to rounding in the compensation term (Neumaier's variant of Kahan
+// summation, which also holds up when val is larger than the sum)
+void SlidingWindowStats::addToSum(double val) {
+  if (sumOverflowed) {
+    return;  // resum() starts over once values have left the window
+  }
+  const double total = finiteSum + val;
+  if (!isfinite(total)) {
+    // Keep the infinity as the sum; the compensation would turn it to NaN
+    sumOverflowed = true;
+    finiteSum = total;
+    compensation = 0.0;
+    return;
+  }
+  if (fabs(finiteSum) >= fabs(val)) {
+    compensation += (finiteSum - total) + val;
+  } else {
+    compensation += (val - total) + finiteSum;
+  }
+  finiteSum = total;
+}
+
+// Private method: sums the finite values in the window again, oldest
+// first, after the running sum overflowed. The sum stays overflowed, and
+// is summed again after the next value is added, while the values in the
+// window still overflow.
+void SlidingWindowStats::resum() {
+  finiteSum = compensation = 0.0;
+  sumOverflowed = false;
+  for (size_t i = 0; i < count && !sumOverflowed; ++i) {
+    const double val = at(i);
+    if (isfinite(val)) {
+      addToSum(val);
+    }
+  }
+}
+
+// Appends a sequence number to the back of the queue
+void SlidingWindowStats::SequenceQueue::push_back(uint64_t seq) {
+  ring[(first + length) % ring.size()] = seq;
+  length++;
+}
+
+// Removes the sequence number at the front of the queue
+void SlidingWindowStats::SequenceQueue::pop_front() {
+  first = (first + 1) % ring.size();
+  length--;
+}
@@ -0,0 +1,129 @@
+#ifndef SLIDINGWINDOWSTATS_HPP_
+#define SLIDINGWINDOWSTATS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// A SlidingWindowStats keeps the last N doubles added to it, and their
+// minimum, maximum, sum and mean.
+//
+// Adding a value takes amortized O(1) time whatever N is, and so does
+// asking for any of the statistics:
+// - the values are kept in a ring, so the oldest one is overwritten
+//   instead of the others being shifted down
+// - the minimum and maximum come from monotonic queues: the candidates for
+//   the maximum, for instance, are the values not followed by a larger
+//   one, kept oldest first, so the maximum is always the front candidate
+//   and every value enters and leaves the queue at most once
+// - the sum is a running sum, to which each new value is added and from
+//   which each evicted value is subtracted, with Neumaier compensation so
+//   that rounding errors do not pile up over millions of updates. The
+//   sum is then often closer to the exact one than adding the window up
+//   oldest first, as accumulate does, and so not always bit for bit the
+//   same: once the values are too large for a double to hold their
+//   fractional digits, the two differ in those digits.
+//
+// When several values tie for the minimum or maximum, the oldest one is
+// reported, as min_element and max_element would; this tells -0.0 and 0.0
+// apart. NaN is handled as they handle it too: every value is compared
+// against the oldest one first, and nothing compares less or greater than
+// NaN, so an oldest value that is NaN is both the minimum and maximum,
+// while a later NaN never is. Infinities and NaN are kept out of the
+// running sum, so the mean is the one of the values currently in the
+// window even after an infinity has left it; a sum that is NaN is the NaN
+// that adding the window up oldest first would give. Likewise, a running
+// sum that overflows is summed again from the window, in O(N), after each
+// value added until it fits in a double again.
+//
+// A SlidingWindowStats is not thread safe.
+///////////////////////////////////////////////////////////////////////////////
+
+class SlidingWindowStats {
+ public:
+  // Constructor for a SlidingWindowStats.
+  // Initializes the window to be empty
+  //
+  // Arguments:
+  // - window: the number of most recent values kept, at least 1
+  explicit SlidingWindowStats(size_t window);
+
+  // Adds a value to the window, evicting the oldest one if the window is
+  // already full
+  //
+  // Arguments:
+  // - val: the value to add
+  void add(double val);
+
+  // Empties the window
+  void clear();
+
+  // Returns the number of values in the window, at most window()
+  size_t size() const { return count; }
+
+  // Returns the most values the window holds
+  size_t window() const { return values.size(); }
+
+  // Returns the i-th value in the window, oldest first
+  //
+  // Arguments:
+  // - i: the position in the window, less than size()
+  double at(size_t i) const;
+
+  // Returns the smallest and largest value in the window, or the oldest
+  // value if it is NaN. Only valid if the window is not empty.
+  double min() const;
+  double max() const;
+
+  // Returns the sum and mean of the values in the window. Only valid if
+  // the window is not empty.
+  double sum() const;
+  double mean() const { return sum() / count; }
+
+ private:
+  // A double-ended queue of sequence numbers on a ring of fixed capacity.
+  // Sequence number s is the s-th value ever added, found in values at
+  // s % window().
+  class SequenceQueue {
+   public:
+    explicit SequenceQueue(size_t capacity) : ring(capacity) {}
+    bool empty() const { return length == 0; }
+    uint64_t front() const { return ring[first]; }
+    uint64_t back() const { return ring[(first + length - 1) % ring.size()]; }
+    void push_back(uint64_t seq);
+    void pop_front();
+    void pop_back() { length--; }
+    void clear() { first = length = 0; }
+
+   private:
+    std::vector<uint64_t> ring;
+    size_t first = 0;
+    size_t length = 0;
+  };
+
+  double valueOf(uint64_t seq) const { return values[seq % values.size()]; }
+  void evict(uint64_t seq);
+  void addToSum(double val);
+  void resum();
+
+  std::vector<double> values;  // the ring of values
+  size_t count;                // values in the window
+  uint64_t nextSeq;            // sequence number of the next value added
+
+  // Candidates for the minimum (increasing) and maximum (decreasing)
+  SequenceQueue minQueue;
+  SequenceQueue maxQueue;
+
+  // The running sum of the finite values, its compensation term, whether
+  // that sum overflowed, and the non-finite values the window holds,
+  // oldest first
+  double finiteSum;
+  double compensation;
+  bool sumOverflowed;
+  SequenceQueue positiveInfinities;
+  SequenceQueue negativeInfinities;
+  SequenceQueue nans;
+};
+
+#endif  // SLIDINGWINDOWSTATS_HPP_
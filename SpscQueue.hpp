@@ -0,0 +1,423 @@
+#ifndef SPSCQUEUE_HPP_
+#define SPSCQUEUE_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+// A SpscQueue<T> is a bounded queue of T values for exactly one producer
+// thread and one consumer thread, such as the reader and printer threads of
+// numbers.
+//
+// The queue supports:
+// - adding one or many values to the end of the queue, waiting for room if
+//   it is full
+// - removing values from the front of the queue
+// - removing one or many values from the front of the queue and waiting
+//   for a value to be added if there isn't one already.
+// At most one thread may add and at most one thread may remove at any time;
+// with more of either, the queue is not thread safe.
+//
+// The values live in a ring. The producer only writes the tail index and
+// the consumer only writes the head index, each on its own cache line and
+// published with release stores, so neither side ever takes a lock. Each
+// side also keeps a cached copy of the other side's index and only reads
+// the shared one when the cached copy says the ring is full or empty.
+//
+// A side that finds the ring empty or full first spins for a while, which
+// is the fast path when both threads are running, then sleeps on a futex.
+// How long it spins adapts to how often spinning was enough recently, and
+// it does not spin at all on a single CPU, where the other side cannot
+// make progress while it spins. A producer sleeping on a full ring is only
+// woken once the consumer has emptied half of it, so that the two threads
+// do not take turns one value at a time.
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class SpscQueue {
+ public:
+  // Constructor for a SpscQueue.
+  // Initializes the queue to be empty with room for at least capacity
+  // values. The capacity is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity = 1024);
+
+  // Destructor for SpscQueue.
+  // Destroys any values left in the queue
+  ~SpscQueue();
+
+  // Adds a value to the end of the queue. If the queue is full, the calling
+  // thread waits until there is room or the queue is closed.
+  // Only one thread may add at a time.
+  //
+  // Arguments:
+  // - val: the value to add to the end of the queue. It is moved into the
+  //   queue if it is an rvalue.
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed
+  bool add(const T& val) { return emplace(val); }
+  bool add(T&& val) { return emplace(std::move(val)); }
+
+  // Constructs a value in place at the end of the queue, waiting for room
+  // like add()
+  template <typename... Args>
+  bool emplace(Args&&... args);
+
+  // Adds a copy of every value of vals to the end of the queue, in order,
+  // publishing as many as there is room for at once and waiting for room
+  // between steps when the queue fills up.
+  // Only one thread may add at a time.
+  //
+  // Arguments:
+  // - vals: the values to add to the end of the queue
+  //
+  // Returns:
+  // - the number of values added: vals.size() if the operation is
+  //   successful, fewer if the queue is closed part way
+  size_t add_bulk(std::span<const T> vals);
+
+  // Same as add(), but never waits
+  //
+  // Returns:
+  // - true if the operation is successful
+  // - false if the queue is closed or full
+  bool try_add(const T& val) { return try_emplace(val); }
+  bool try_add(T&& val) { return try_emplace(std::move(val)); }
+  template <typename... Args>
+  bool try_emplace(Args&&... args);
+
+  // Closes the queue.
+  //
+  // Calls to add() after close fail and return false, including a call
+  // waiting on a full queue. Values added before close can still be
+  // removed, after which removing returns nullopt instead of waiting.
+  // This operation may be called from any thread.
+  void close();
+
+  // Removes a value from the front of the queue
+  // Only one thread may remove at a time.
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if there were no values in the queue
+  std::optional<T> try_remove();
+
+  // Removes a value from the front of the queue, waiting for one to be
+  // added if the queue is empty.
+  // Only one thread may remove at a time.
+  //
+  // Returns:
+  // - The value removed from the front of the queue
+  // - nullopt if the queue is closed and empty
+  std::optional<T> wait_remove();
+
+  // Removes up to max values from the front of the queue into out, waiting
+  // like wait_remove() if the queue is empty.
+  // Only one thread may remove at a time.
+  //
+  // Arguments:
+  // - out: where to move the removed values, in queue order
+  // - max: the most values to remove; out.size() is used if it is smaller
+  //
+  // Returns:
+  // - the number of values removed, at least one
+  // - 0 if the queue is closed and empty
+  size_t wait_remove_bulk(std::span<T> out, size_t max);
+
+  // Returns the number of values in the queue
+  // This operation may be called from any thread.
+  int length() const;
+
+  // Returns the number of values the queue can hold
+  size_t capacity() const { return mask + 1; }
+
+  SpscQueue(const SpscQueue& other) = delete;
+  SpscQueue& operator=(const SpscQueue& other) = delete;
+
+ private:
+  // A slot of the ring; holds a value between tail and head
+  struct Slot {
+    alignas(T) unsigned char storage[sizeof(T)];
+    T& value() { return *std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  // How one side waits: spins, adapting between the limits, then sleeps
+  static constexpr int kMinSpins = 16;
+  static constexpr int kMaxSpins = 4096;
+  struct Waiter {
+    std::atomic<uint32_t> epoch{0};
+    std::atomic<bool> parked{false};
+    int spins;  // only used by the waiting side
+  };
+
+  template <typename Ready>
+  void waitUntil(Waiter& waiter, Ready ready);
+  void wake(Waiter& waiter);
+  void wakeProducer(size_t newHead);
+  bool closed() const { return isClosed.load(std::memory_order_acquire); }
+  size_t available();
+
+  // Fields
+  // Written by the producer: the next position to write, and its last
+  // look at head
+  alignas(64) std::atomic<size_t> tail{0};
+  size_t cachedHead = 0;
+  // Written by the consumer: the next position to read, and its last look
+  // at tail
+  alignas(64) std::atomic<size_t> head{0};
+  size_t cachedTail = 0;
+
+  alignas(64) Waiter consumer;  // sleeps on an empty ring
+  alignas(64) Waiter producer;  // sleeps on a full ring
+  alignas(64) std::atomic<bool> isClosed{false};
+  size_t mask;
+  std::unique_ptr<Slot[]> slots;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// SpscQueue implementation
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+SpscQueue<T>::SpscQueue(size_t capacity)
+    : mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+      slots(std::make_unique<Slot[]>(mask + 1)) {
+  const int spins = std::thread::hardware_concurrency() > 1 ? kMaxSpins : 0;
+  consumer.spins = spins;
+  producer.spins = spins;
+}
+
+template <typename T>
+SpscQueue<T>::~SpscQueue() {
+  for (size_t pos = head.load(); pos != tail.load(); ++pos) {
+    slots[pos & mask].value().~T();
+  }
+}
+
+// Constructs a value at the end of the queue, waiting while it is full
+template <typename T>
+template <typename... Args>
+bool SpscQueue<T>::emplace(Args&&... args) {
+  const size_t pos = tail.load(std::memory_order_relaxed);
+  if (pos - cachedHead > mask) {
+    waitUntil(producer, [&] {
+      cachedHead = head.load(std::memory_order_acquire);
+      return pos - cachedHead <= mask || closed();
+    });
+  }
+  return try_emplace(std::forward<Args>(args)...);
+}
+
+// Adds a batch of values to the end of the queue, a ring's worth at most
+// at a time
+template <typename T>
+size_t SpscQueue<T>::add_bulk(std::span<const T> vals) {
+  size_t added = 0;
+  while (added < vals.size()) {
+    const size_t pos = tail.load(std::memory_order_relaxed);
+    if (pos - cachedHead > mask) {
+      waitUntil(producer, [&] {
+        cachedHead = head.load(std::memory_order_acquire);
+        return pos - cachedHead <= mask || closed();
+      });
+    }
+    if (closed()) {
+      break;
+    }
+    cachedHead = head.load(std::memory_order_acquire);
+    const size_t count =
+        std::min(vals.size() - added, capacity() - (pos - cachedHead));
+    size_t built = 0;
+    try {
+      for (; built < count; ++built) {
+        new (slots[(pos + built) & mask].storage) T(vals[added + built]);
+      }
+    } catch (...) {
+      // Nothing was published yet, so undo this step and pass the error on
+      for (size_t i = 0; i < built; ++i) {
+        slots[(pos + i) & mask].value().~T();
+      }
+      throw;
+    }
+    // One release store publishes the whole step
+    tail.store(pos + count, std::memory_order_release);
+    wake(consumer);
+    added += count;
+  }
+  return added;
+}
+
+// Constructs a value at the end of the queue unless it is full
+template <typename T>
+template <typename... Args>
+bool SpscQueue<T>::try_emplace(Args&&... args) {
+  if (closed()) {
+    return false;
+  }
+  const size_t pos = tail.load(std::memory_order_relaxed);
+  if (pos - cachedHead > mask) {
+    cachedHead = head.load(std::memory_order_acquire);
+    if (pos - cachedHead > mask) {
+      return false;
+    }
+  }
+  new (slots[pos & mask].storage) T(std::forward<Args>(args)...);
+  tail.store(pos + 1, std::memory_order_release);
+  wake(consumer);
+  return true;
+}
+
+// Closes the queue and wakes both sides
+template <typename T>
+void SpscQueue<T>::close() {
+  isClosed.store(true, std::memory_order_release);
+  for (Waiter* waiter : {&consumer, &producer}) {
+    waiter->epoch.fetch_add(1);
+    waiter->epoch.notify_all();
+  }
+}
+
+// Removes a value from the front of the queue without waiting
+template <typename T>
+std::optional<T> SpscQueue<T>::try_remove() {
+  if (available() == 0) {
+    return std::nullopt;
+  }
+  const size_t pos = head.load(std::memory_order_relaxed);
+  T& slot = slots[pos & mask].value();
+  std::optional<T> val(std::move(slot));
+  slot.~T();
+  head.store(pos + 1, std::memory_order_release);
+  wakeProducer(pos + 1);
+  return val;
+}
+
+// Removes a value from the front of the queue, waiting while it is empty
+// and open
+template <typename T>
+std::optional<T> SpscQueue<T>::wait_remove() {
+  if (available() == 0) {
+    waitUntil(consumer, [&] { return available() > 0 || closed(); });
+  }
+  // If the queue was closed, values added before close are still there
+  return try_remove();
+}
+
+// Removes a batch of values from the front of the queue, waiting while it
+// is empty and open
+template <typename T>
+size_t SpscQueue<T>::wait_remove_bulk(std::span<T> out, size_t max) {
+  max = std::min(max, out.size());
+  if (max == 0) {
+    return 0;
+  }
+  if (available() == 0) {
+    waitUntil(consumer, [&] { return available() > 0 || closed(); });
+  }
+  const size_t count = std::min(max, available());
+  const size_t pos = head.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < count; ++i) {
+    T& slot = slots[(pos + i) & mask].value();
+    out[i] = std::move(slot);
+    slot.~T();
+  }
+  if (count > 0) {
+    head.store(pos + count, std::memory_order_release);
+    wakeProducer(pos + count);
+  }
+  return count;
+}
+
+// Returns the number of values in the queue
+template <typename T>
+int SpscQueue<T>::length() const {
+  const size_t first = head.load(std::memory_order_acquire);
+  const size_t last = tail.load(std::memory_order_acquire);
+  return last > first ? static_cast<int>(last - first) : 0;
+}
+
+// Private method for the consumer: returns how many values are ready,
+// reading the shared tail only if the cached one shows none
+template <typename T>
+size_t SpscQueue<T>::available() {
+  const size_t pos = head.load(std::memory_order_relaxed);
+  if (cachedTail == pos) {
+    cachedTail = tail.load(std::memory_order_acquire);
+  }
+  return cachedTail - pos;
+}
+
+// Private method: waits until ready() returns true, by spinning for up to
+// waiter.spins checks and then sleeping until the other side wakes this one
+template <typename T>
+template <typename Ready>
+void SpscQueue<T>::waitUntil(Waiter& waiter, Ready ready) {
+  for (int i = 0; i < waiter.spins; ++i) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+    if (ready()) {
+      // Spinning paid off, so allow a little more of it next time
+      waiter.spins = std::min(waiter.spins * 2, kMaxSpins);
+      return;
+    }
+  }
+  if (waiter.spins > 0) {
+    waiter.spins = std::max(waiter.spins / 2, kMinSpins);
+  }
+  while (true) {
+    // Announce the sleep before checking again, so that the other side
+    // either sees it after its update and wakes this thread, or the check
+    // below sees the update
+    waiter.parked.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint32_t epoch = waiter.epoch.load();
+    if (ready()) {
+      waiter.parked.store(false, std::memory_order_relaxed);
+      return;
+    }
+    waiter.epoch.wait(epoch);
+    waiter.parked.store(false, std::memory_order_relaxed);
+  }
+}
+
+// Private method: wakes the other side if it is asleep. The fence orders
+// the index update made by the caller before the read of parked, pairing
+// with the fence in waitUntil().
+template <typename T>
+void SpscQueue<T>::wake(Waiter& waiter) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  // Only the first update after the other side parks pays for the wake
+  if (waiter.parked.load(std::memory_order_relaxed) &&
+      waiter.parked.exchange(false)) {
+    waiter.epoch.fetch_add(1);
+    waiter.epoch.notify_one();
+  }
+}
+
+// Private method for the consumer: wakes a sleeping producer once at most
+// half of the ring is in use. The consumer's cached tail may be behind, so
+// the check can only err towards waking early, and a consumer that keeps
+// removing always gets there.
+template <typename T>
+void SpscQueue<T>::wakeProducer(size_t newHead) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (producer.parked.load(std::memory_order_relaxed) &&
+      cachedTail - newHead <= capacity() / 2 &&
+      producer.parked.exchange(false)) {
+    producer.epoch.fetch_add(1);
+    producer.epoch.notify_one();
+  }
+}
+
+#endif  // SPSCQUEUE_HPP_
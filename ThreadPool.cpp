@@ -0,0 +1,186 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// The worker index of the current thread, -1 outside of a pool, and the
+// pool it works for
+thread_local int current_worker_id = -1;
+thread_local const ThreadPool* current_pool = nullptr;
+
+// Chunks per worker when the caller lets the pool pick the grain size.
+// More chunks balance better; fewer cost less to hand out.
+constexpr size_t kChunksPerWorker = 8;
+
+}  // namespace
+
+ThreadPool::ThreadPool(unsigned thread_count) {
+  if (thread_count == 0) {
+    thread_count = max(1U, thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < thread_count; ++i) {
+    queues.push_back(make_unique<WorkerQueue>());
+  }
+  for (unsigned i = 0; i < thread_count; ++i) {
+    workers.emplace_back(&ThreadPool::worker_loop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> guard(state_lock);
+    stopping = true;
+  }
+  work_ready.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallel_for(size_t begin,
+                              size_t end,
+                              size_t grain,
+                              const function<void(size_t, size_t)>& body) {
+  if (begin >= end) {
+    return;
+  }
+  const size_t count = end - begin;
+  if (grain == 0) {
+    grain = max<size_t>(1, count / (size() * kChunksPerWorker));
+  }
+  // The loop running on this worker cannot finish until the call returns,
+  // so handing the chunks to the other workers would deadlock
+  if (current_pool == this) {
+    run_inline(begin, end, grain, body);
+    return;
+  }
+  lock_guard<mutex> loop_guard(loop_lock);
+
+  const size_t chunk_count = (count + grain - 1) / grain;
+
+  // Give each worker a contiguous share of the chunks so that neighboring
+  // items stay on the same core unless they get stolen
+  remaining.store(chunk_count);
+  const size_t per_worker = chunk_count / size();
+  const size_t extra = chunk_count % size();
+  size_t chunk_begin = begin;
+  for (unsigned i = 0; i < size(); ++i) {
+    const size_t share = per_worker + (i < extra ? 1 : 0);
+    lock_guard<mutex> guard(queues[i]->lock);
+    for (size_t c = 0; c < share; ++c) {
+      const size_t chunk_end = min(end, chunk_begin + grain);
+      queues[i]->chunks.push_back(Chunk{chunk_begin, chunk_end, &body});
+      chunk_begin = chunk_end;
+    }
+  }
+
+  unique_lock<mutex> lock(state_lock);
+  ++generation;
+  work_ready.notify_all();
+  work_done.wait(lock, [this] { return remaining.load() == 0; });
+
+  exception_ptr thrown = exchange(error, nullptr);
+  lock.unlock();
+  if (thrown) {
+    rethrow_exception(thrown);
+  }
+}
+
+int ThreadPool::current_worker() {
+  return current_worker_id;
+}
+
+void ThreadPool::worker_loop(unsigned id) {
+  current_worker_id = static_cast<int>(id);
+  current_pool = this;
+  unsigned long seen = 0;
+  while (true) {
+    {
+      unique_lock<mutex> lock(state_lock);
+      work_ready.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+    }
+    run_chunks(id);
+  }
+}
+
+void ThreadPool::run_chunks(unsigned id) {
+  Chunk chunk;
+  while (pop_local(id, chunk) || steal(id, chunk)) {
+    try {
+      (*chunk.body)(chunk.begin, chunk.end);
+    } catch (...) {
+      lock_guard<mutex> guard(state_lock);
+      if (!error) {
+        error = current_exception();
+      }
+    }
+    // The last chunk wakes the caller. Notifying under the lock keeps the
+    // caller from missing the wakeup between its check and its wait.
+    if (remaining.fetch_sub(1) == 1) {
+      lock_guard<mutex> guard(state_lock);
+      work_done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::run_inline(size_t begin,
+                            size_t end,
+                            size_t grain,
+                            const function<void(size_t, size_t)>& body) {
+  exception_ptr thrown;
+  for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += grain) {
+    try {
+      body(chunk_begin, min(end, chunk_begin + grain));
+    } catch (...) {
+      if (!thrown) {
+        thrown = current_exception();
+      }
+    }
+  }
+  if (thrown) {
+    rethrow_exception(thrown);
+  }
+}
+
+bool ThreadPool::pop_local(unsigned id, Chunk& chunk) {
+  WorkerQueue& own = *queues[id];
+  lock_guard<mutex> guard(own.lock);
+  if (own.chunks.empty()) {
+    return false;
+  }
+  chunk = own.chunks.front();
+  own.chunks.pop_front();
+  return true;
+}
+
+bool ThreadPool::steal(unsigned id, Chunk& chunk) {
+  vector<Chunk> stolen;
+  for (unsigned offset = 1; offset < size() && stolen.empty(); ++offset) {
+    WorkerQueue& victim = *queues[(id + offset) % size()];
+    lock_guard<mutex> guard(victim.lock);
+    const size_t take = (victim.chunks.size() + 1) / 2;
+    auto first = victim.chunks.end() - static_cast<ptrdiff_t>(take);
+    stolen.assign(first, victim.chunks.end());
+    victim.chunks.erase(first, victim.chunks.end());
+  }
+  if (stolen.empty()) {
+    return false;
+  }
+
+  // Only one deque is locked at a time, so two workers stealing from each
+  // other cannot deadlock
+  chunk = stolen.front();
+  WorkerQueue& own = *queues[id];
+  lock_guard<mutex> guard(own.lock);
+  own.chunks.insert(own.chunks.end(), next(stolen.begin()), stolen.end());
+  return true;
+}
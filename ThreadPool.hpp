@@ -0,0 +1,128 @@
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// A ThreadPool is a fixed set of worker threads that run parallel loops.
+//
+// A loop over [begin, end) is cut into chunks of about grain items. Each
+// worker starts with its own contiguous share of the chunks in a private
+// deque and takes chunks from the front of it in order. A worker whose deque
+// runs dry steals the back half of another worker's deque, so workers that
+// got cheap chunks, or more CPU time, take over the work of slower ones
+// instead of sitting idle.
+//
+// The workers are started once and reused by every loop, so short loops do
+// not pay for creating threads.
+///////////////////////////////////////////////////////////////////////////////
+
+class ThreadPool {
+ public:
+  // Starts thread_count worker threads.
+  // A thread_count of 0 uses one worker per hardware thread.
+  explicit ThreadPool(unsigned thread_count = 0);
+
+  // Stops and joins every worker. Must not be called during parallel_for().
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Returns the number of worker threads.
+  unsigned size() const { return queues.size(); }
+
+  // Calls body(chunk_begin, chunk_end) on the workers for consecutive,
+  // non-overlapping chunks [chunk_begin, chunk_end) that together cover
+  // [begin, end), and returns once every chunk is done. Chunks may run in
+  // any order and concurrently, so body must be safe to call from several
+  // threads at once. Calls from several threads are run one after another.
+  // A call from one of this pool's own workers, from inside body, runs
+  // every chunk on the calling worker instead, since the other workers may
+  // be waiting for it.
+  //
+  // If body throws, the remaining chunks are still run and the first
+  // exception is rethrown to the caller.
+  //
+  // Arguments:
+  // - begin, end: the half-open range of items to process
+  // - grain: the number of items per chunk. 0 picks a size that gives every
+  //   worker several chunks to balance.
+  // - body: the function that processes one chunk
+  void parallel_for(size_t begin,
+                    size_t end,
+                    size_t grain,
+                    const std::function<void(size_t, size_t)>& body);
+
+  // Returns the index in [0, size()) of the worker running the calling
+  // thread, or -1 if the caller is not a worker of any pool. Workers of a
+  // pool may call parallel_for() on it; see above.
+  static int current_worker();
+
+ private:
+  // A chunk of a loop and the body to run on it
+  struct Chunk {
+    size_t begin;
+    size_t end;
+    const std::function<void(size_t, size_t)>* body;
+  };
+
+  // The deque of chunks owned by one worker. Padded to a cache line so that
+  // workers locking their own deques do not contend on the same line.
+  struct alignas(64) WorkerQueue {
+    std::mutex lock;
+    std::deque<Chunk> chunks;
+  };
+
+  // The loop run by each worker thread
+  void worker_loop(unsigned id);
+
+  // Runs every chunk of a loop on the calling thread, for a parallel_for()
+  // called by one of the pool's own workers.
+  void run_inline(size_t begin,
+                  size_t end,
+                  size_t grain,
+                  const std::function<void(size_t, size_t)>& body);
+
+  // Runs chunks of the current loop, first from the worker's own deque and
+  // then stolen from others, until no chunk is left to take.
+  void run_chunks(unsigned id);
+
+  // Takes the next chunk from the front of the worker's own deque.
+  // Returns false if it is empty.
+  bool pop_local(unsigned id, Chunk& chunk);
+
+  // Moves the back half of another worker's deque to the worker's own deque
+  // and takes the first stolen chunk. Returns false if every deque is empty.
+  bool steal(unsigned id, Chunk& chunk);
+
+  // Fields
+  std::vector<std::unique_ptr<WorkerQueue>> queues;
+  std::vector<std::thread> workers;
+
+  // Serializes concurrent calls to parallel_for()
+  std::mutex loop_lock;
+
+  // Guards generation, stopping and error, and wakes workers for a new loop
+  // and the caller when the loop is done
+  std::mutex state_lock;
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+  unsigned long generation = 0;
+  bool stopping = false;
+  std::exception_ptr error;
+
+  // The number of chunks of the current loop not yet finished
+  std::atomic<size_t> remaining{0};
+};
+
+#endif  // THREADPOOL_HPP_
@@ -0,0 +1,140 @@
+/* Compares the time and peak memory of loading a BMP file by reading it
+   into memory against mapping it.
+
+   Each load mode runs in its own child process so that the peak resident
+   set size reported for one mode is not inflated by the other. Mapped
+   pages count towards the resident set as file-backed pages, which the
+   kernel can drop at any time, so the private (anonymous) memory of each
+   mode is reported as well. For cold cache numbers, drop the page cache
+   before each run. */
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "qdbmp.hpp"
+
+using namespace std;
+
+namespace {
+
+// Writes a width x height 32 BPP gradient image to file
+int generate(UINT width, UINT height, const string& file) {
+  BitMap image(width, height);
+  if (image.check_error() != BMP_OK) {
+    cerr << "ERROR: " << image.error_description() << endl;
+    return EXIT_FAILURE;
+  }
+  for (UINT y = 0; y < height; ++y) {
+    RowSpan row = image.row(y);
+    for (UINT x = 0; x < width; ++x) {
+      UCHAR* pixel = row.pixel(x);
+      pixel[RowSpan::kRed] = static_cast<UCHAR>(x);
+      pixel[RowSpan::kGreen] = static_cast<UCHAR>(y);
+      pixel[RowSpan::kBlue] = static_cast<UCHAR>(x ^ y);
+    }
+  }
+  image.write_file(file);
+  if (image.check_error() != BMP_OK) {
+    cerr << "ERROR: " << image.error_description() << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Returns the anonymous resident memory of this process in KB,
+// or -1 if /proc is not available
+long private_kb() {
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line)) {
+    if (line.rfind("RssAnon:", 0) == 0) {
+      return stol(line.substr(line.find_first_of("0123456789")));
+    }
+  }
+  return -1;
+}
+
+// Loads file with the given mode, then reads rows_pct percent of its rows,
+// spread evenly over the image. Prints one line of results.
+int measure(const string& name,
+            BitMap::LoadMode mode,
+            const string& file,
+            int rows_pct) {
+  using Clock = chrono::steady_clock;
+
+  Clock::time_point start = Clock::now();
+  BitMap image(file, mode);
+  if (image.check_error() != BMP_OK) {
+    cerr << "ERROR: " << image.error_description() << endl;
+    return EXIT_FAILURE;
+  }
+  Clock::time_point loaded = Clock::now();
+
+  // Sum the touched bytes so the reads cannot be optimized away
+  unsigned long checksum = 0;
+  const UINT height = image.height();
+  const UINT step = rows_pct >= 100 ? 1 : 100 / max(rows_pct, 1);
+  for (UINT y = 0; y < height; y += step) {
+    RowSpan row = image.row(y);
+    for (UINT i = 0; i < row.size_bytes(); ++i) {
+      checksum += row.data[i];
+    }
+  }
+  Clock::time_point scanned = Clock::now();
+
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+
+  auto ms = [](Clock::duration d) {
+    return chrono::duration<double, milli>(d).count();
+  };
+  cout << setw(6) << name << setw(12) << ms(loaded - start) << setw(12)
+       << ms(scanned - loaded) << setw(16) << usage.ru_maxrss << setw(14)
+       << private_kb() << "   " << checksum << endl;
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc == 5 && string(argv[1]) == "--generate") {
+    return generate(stoul(argv[2]), stoul(argv[3]), argv[4]);
+  }
+  if (argc != 2 && argc != 3) {
+    cerr << "Usage: " << argv[0] << " <bmp file> [rows_pct]" << endl;
+    cerr << "       " << argv[0] << " --generate <width> <height> <bmp file>"
+         << endl;
+    return EXIT_FAILURE;
+  }
+
+  string file{argv[1]};
+  int rows_pct = argc == 3 ? stoi(argv[2]) : 100;
+
+  cout << fixed << setprecision(2);
+  cout << setw(6) << "mode" << setw(12) << "load ms" << setw(12) << "scan ms"
+       << setw(16) << "peak RSS KB" << setw(14) << "private KB"
+       << "   checksum" << endl;
+
+  const pair<string, BitMap::LoadMode> modes[] = {
+      {"read", BitMap::LoadMode::kRead},
+      {"map", BitMap::LoadMode::kMap},
+  };
+  for (const auto& [name, mode] : modes) {
+    pid_t child = fork();
+    if (child == 0) {
+      _exit(measure(name, mode, file, rows_pct));
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
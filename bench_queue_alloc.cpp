@@ -0,0 +1,126 @@
+/* Counts the heap allocations DoubleQueue makes under sustained load.
+
+   Producer threads add values, one at a time and in batches, while
+   consumer threads remove them. A first round warms the queue up, then a
+   second, identical round is measured: every call to operator new made by
+   the process during that round is counted and reported per million queue
+   operations (adds plus removes). */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DoubleQueue.hpp"
+
+using namespace std;
+
+namespace {
+
+atomic<bool> counting{false};
+atomic<long> allocations{0};
+
+// Values added per add_bulk() call by the batching producers
+constexpr size_t kBatch = 16;
+
+// Runs one round of ops adds, spread over producers, and as many removes,
+// spread over consumers. Returns the elapsed seconds.
+double run_round(DoubleQueue& queue, long ops, int producers, int consumers) {
+  // The threads are created before counting starts and wait for go, so
+  // that their own allocations are not counted
+  atomic<bool> go{false};
+  atomic<long> removed{0};
+  vector<thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      while (!go) {
+        this_thread::yield();
+      }
+      const long share = ops / producers + (p < ops % producers ? 1 : 0);
+      double batch[kBatch] = {};
+      long i = 0;
+      // Even producers add one value at a time, odd ones in batches
+      while (i < share) {
+        if (p % 2 == 0 || share - i < static_cast<long>(kBatch)) {
+          queue.add(static_cast<double>(i));
+          i++;
+        } else {
+          queue.add_bulk(span<const double>(batch, kBatch));
+          i += kBatch;
+        }
+      }
+    });
+  }
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&] {
+      while (!go) {
+        this_thread::yield();
+      }
+      while (removed.fetch_add(1) < ops) {
+        queue.wait_remove();
+      }
+    });
+  }
+
+  auto start = chrono::steady_clock::now();
+  counting = true;
+  go = true;
+  for (auto& th : threads) {
+    th.join();
+  }
+  counting = false;
+  return chrono::duration<double>(chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+// Counts every allocation made while a round is being measured
+void* operator new(size_t size) {
+  if (counting.load(memory_order_relaxed)) {
+    allocations.fetch_add(1, memory_order_relaxed);
+  }
+  if (void* ptr = malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 4) {
+    cerr << "Usage: " << argv[0] << " [ops] [producers] [consumers]" << endl;
+    return EXIT_FAILURE;
+  }
+  const long ops = argc > 1 ? stol(argv[1]) : 1000000;
+  const int producers = argc > 2 ? stoi(argv[2]) : 2;
+  const int consumers = argc > 3 ? stoi(argv[3]) : 2;
+
+  DoubleQueue queue;
+  run_round(queue, ops, producers, consumers);
+  allocations = 0;
+  double seconds = run_round(queue, ops, producers, consumers);
+
+  // Each value is added once and removed once
+  const double total_ops = 2.0 * ops;
+  cout << fixed << setprecision(1);
+  cout << "ops:                    " << static_cast<long>(total_ops) << endl;
+  cout << "allocations:            " << allocations << endl;
+  cout << "allocations per 1M ops: " << allocations * 1e6 / total_ops
+       << endl;
+  cout << "ops per second:         " << total_ops / seconds << endl;
+  return EXIT_SUCCESS;
+}
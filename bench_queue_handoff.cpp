@@ -0,0 +1,89 @@
+/* Measures the cost of handing values from one producer thread to one
+   consumer thread, through ConcurrentQueue and through SpscQueue.
+
+   Two numbers are printed for each queue:
+   - streaming: the producer adds values as fast as it can and the consumer
+     removes them one at a time; the time per value is the throughput cost
+   - round trip: a value goes to the consumer through one queue and back
+     through a second one before the next is sent; half of a round trip is
+     the latency of a single handoff. */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "ConcurrentQueue.hpp"
+#include "SpscQueue.hpp"
+
+using namespace std;
+
+namespace {
+
+// Returns the nanoseconds per value of streaming values through queue
+template <typename Queue>
+double streaming(Queue& queue, long values) {
+  auto start = chrono::steady_clock::now();
+  thread producer([&] {
+    for (long i = 0; i < values; ++i) {
+      queue.add(static_cast<double>(i));
+    }
+    queue.close();
+  });
+  while (queue.wait_remove()) {
+  }
+  producer.join();
+  chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count() / values;
+}
+
+// Returns the nanoseconds of one handoff, as half a round trip through
+// there and back
+template <typename Queue>
+double round_trip(Queue& there, Queue& back, long values) {
+  thread echo([&] {
+    while (optional<double> val = there.wait_remove()) {
+      back.add(*val);
+    }
+    back.close();
+  });
+  auto start = chrono::steady_clock::now();
+  for (long i = 0; i < values; ++i) {
+    there.add(static_cast<double>(i));
+    back.wait_remove();
+  }
+  chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+  there.close();
+  echo.join();
+  return elapsed.count() / values / 2;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc > 2) {
+    cerr << "Usage: " << argv[0] << " [values]" << endl;
+    return EXIT_FAILURE;
+  }
+  const long values = argc > 1 ? stol(argv[1]) : 1000000;
+
+  cout << fixed << setprecision(1);
+  cout << setw(18) << "queue" << setw(16) << "streaming ns" << setw(16)
+       << "handoff ns" << endl;
+  {
+    ConcurrentQueue<double> stream(1024), there, back;
+    double per_value = streaming(stream, values);
+    double handoff = round_trip(there, back, values / 10);
+    cout << setw(18) << "ConcurrentQueue" << setw(16) << per_value
+         << setw(16) << handoff << endl;
+  }
+  {
+    SpscQueue<double> stream(1024), there, back;
+    double per_value = streaming(stream, values);
+    double handoff = round_trip(there, back, values / 10);
+    cout << setw(18) << "SpscQueue" << setw(16) << per_value << setw(16)
+         << handoff << endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/* Compares how ConcurrentQueue and ShardedQueue scale with the number of
+   producer threads.
+
+   For each producer count from 1 to 64, the producers add a fixed total
+   number of values between them while a fixed number of consumers remove
+   them, once through a single-lock ConcurrentQueue and once through a
+   ShardedQueue with one lane per producer (up to the number of lanes
+   given). The throughput in values per second is printed for both. */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ConcurrentQueue.hpp"
+#include "ShardedQueue.hpp"
+
+using namespace std;
+
+namespace {
+
+// Moves total values from producers to consumers through queue and
+// returns the values moved per second
+template <typename Queue>
+double measure(Queue& queue, long total, int producers, int consumers) {
+  atomic<bool> go{false};
+  vector<thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      while (!go) {
+        this_thread::yield();
+      }
+      const long share = total / producers + (p < total % producers ? 1 : 0);
+      for (long i = 0; i < share; ++i) {
+        queue.add(i);
+      }
+    });
+  }
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&] {
+      while (!go) {
+        this_thread::yield();
+      }
+      while (queue.wait_remove()) {
+      }
+    });
+  }
+
+  auto start = chrono::steady_clock::now();
+  go = true;
+  for (int p = 0; p < producers; ++p) {
+    threads[p].join();
+  }
+  queue.close();
+  for (size_t t = producers; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return total / seconds;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc > 4) {
+    cerr << "Usage: " << argv[0] << " [values] [consumers] [max_lanes]"
+         << endl;
+    return EXIT_FAILURE;
+  }
+  const long total = argc > 1 ? stol(argv[1]) : 1000000;
+  const int consumers = argc > 2 ? stoi(argv[2]) : 4;
+  const int max_lanes = argc > 3 ? stoi(argv[3]) : 64;
+
+  cout << fixed << setprecision(0);
+  cout << setw(10) << "producers" << setw(8) << "lanes" << setw(16)
+       << "single lock/s" << setw(16) << "sharded/s" << setw(10) << "speedup"
+       << endl;
+  for (int producers = 1; producers <= 64; producers *= 2) {
+    ConcurrentQueue<long> single;
+    double single_rate = measure(single, total, producers, consumers);
+    const int lanes = min(producers, max_lanes);
+    ShardedQueue<long> sharded(lanes);
+    double sharded_rate = measure(sharded, total, producers, consumers);
+    cout << setw(10) << producers << setw(8) << lanes << setw(16)
+         << single_rate << setw(16) << sharded_rate << setw(10)
+         << setprecision(2) << sharded_rate / single_rate << setprecision(0)
+         << endl;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/* Counts the context switches a ConcurrentQueue causes per added element
+   when many consumers are blocked in wait_remove().
+
+   For each consumer count, the consumers are started and left to block on
+   the empty queue. The producer then adds one element at a time and waits
+   for it to be removed before adding the next, so that every add finds all
+   consumers asleep. The voluntary and involuntary context switches of the
+   whole process during the adds are divided by the number of elements. */
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ConcurrentQueue.hpp"
+
+using namespace std;
+
+namespace {
+
+// Returns the context switches of every thread of the process so far
+long context_switches() {
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// Measures one consumer count and prints one line of results
+void measure(int consumers, int elements) {
+  ConcurrentQueue<int> queue;
+  atomic<int> removed{0};
+  vector<thread> threads;
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&] {
+      while (queue.wait_remove()) {
+        removed++;
+      }
+    });
+  }
+  // Give every consumer time to block on the empty queue
+  this_thread::sleep_for(chrono::milliseconds(100));
+
+  auto start = chrono::steady_clock::now();
+  long before = context_switches();
+  for (int i = 0; i < elements; ++i) {
+    queue.add(i);
+    while (removed.load() <= i) {
+      this_thread::yield();
+    }
+  }
+  long switches = context_switches() - before;
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  queue.close();
+  for (auto& th : threads) {
+    th.join();
+  }
+  cout << setw(10) << consumers << setw(14) << switches << setw(20)
+       << static_cast<double>(switches) / elements << setw(14)
+       << elements / seconds << endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc > 2) {
+    cerr << "Usage: " << argv[0] << " [elements]" << endl;
+    return EXIT_FAILURE;
+  }
+  const int elements = argc > 1 ? stoi(argv[1]) : 2000;
+
+  cout << fixed << setprecision(2);
+  cout << setw(10) << "consumers" << setw(14) << "switches" << setw(20)
+       << "switches/element" << setw(14) << "elements/s" << endl;
+  for (int consumers : {1, 4, 16, 64}) {
+    measure(consumers, elements);
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,32 +1,57 @@
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
-#include <mutex>
+#include <numeric>
 #include <string>
-#include <thread>
 #include <vector>
+#include "BoxBlur.hpp"
+#include "ThreadPool.hpp"
 #include "qdbmp.hpp"
 
 using namespace std;
 
-constexpr UCHAR MAX_COLOR_VALUE = 255U;
 unsigned int height;
 unsigned int width;
-mutex blurMutex;
 
-void processSection(int startX,
-                    int startY,
-                    int endX,
-                    int endY,
-                    BitMap& image,
-                    BitMap& blur,
-                    int blockSize);
+// Runs process(start, end) on the pool for inclusive sections of
+// [0, count) until all of them are done.
+template <typename Function>
+void forEachSection(ThreadPool& pool, UINT count, Function process);
+
+// How long one tile took and which worker ran it
+struct TileTiming {
+  int worker;
+  long micros;
+};
+
+// Parses the value of a "--tile=<size>" or "--tile=<width>x<height>" flag.
+// Returns false if it is not one or two positive integers.
+bool parseTileSize(const string& value, UINT& tileWidth, UINT& tileHeight);
+
+// Blurs every tile on the pool, one tile per chunk. Returns the time each
+// tile took, in the same order as tiles.
+vector<TileTiming> blurTiles(ThreadPool& pool,
+                             BitMap& image,
+                             BitMap& blur,
+                             int block_size,
+                             const vector<Tile>& tiles);
+
+// Prints a summary of the tile timings and, if reportFile is not empty,
+// writes every tile's timing to it as CSV.
+void reportTiles(const vector<Tile>& tiles,
+                 const vector<TileTiming>& timings,
+                 const string& reportFile);
 
 int main(int argc, char* argv[]) {
   // Check input commands
-  if (argc != 5) {
+  if (argc < 5) {
     cerr << "Usage: " << argv[0]
-         << " <input file> <output_file> <block_size> <thread_count>" << endl;
+         << " <input file> <output_file> <block_size> <thread_count>"
+         << " [--mode=auto|naive|sat|separable]"
+         << " [--tile=<size>|<width>x<height>] [--tile-report=<csv file>]"
+         << endl;
     return EXIT_FAILURE;
   }
 
@@ -79,13 +104,53 @@ int main(int argc, char* argv[]) {
     cerr << "The input threads count is out of integer range." << endl;
     return EXIT_FAILURE;
   }
+
+  // Check the optional flags
+  BlurMode mode = BlurMode::kAuto;
+  UINT tileWidth = 0, tileHeight = 0;
+  string tileReport;
+  for (int i = 5; i < argc; ++i) {
+    string flag{argv[i]};
+    if (flag.rfind("--mode=", 0) == 0) {
+      optional<BlurMode> parsed = parse_blur_mode(flag);
+      if (!parsed) {
+        cerr << "The blur mode should be one of "
+             << "--mode=auto|naive|sat|separable." << endl;
+        return EXIT_FAILURE;
+      }
+      mode = *parsed;
+    } else if (flag.rfind("--tile=", 0) == 0) {
+      if (!parseTileSize(flag.substr(7), tileWidth, tileHeight)) {
+        cerr << "The tile size should be --tile=<size> or "
+             << "--tile=<width>x<height> with positive integers." << endl;
+        return EXIT_FAILURE;
+      }
+    } else if (flag.rfind("--tile-report=", 0) == 0) {
+      tileReport = flag.substr(14);
+    } else {
+      cerr << "Unknown option " << flag << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  bool tiled = tileWidth > 0;
+  if (tiled && mode != BlurMode::kAuto && mode != BlurMode::kSeparable) {
+    cerr << "Tiled execution uses the separable blur." << endl;
+    return EXIT_FAILURE;
+  }
+  mode = tiled ? BlurMode::kSeparable
+               : resolve_parallel_blur_mode(mode, block_size);
+  if (!tileReport.empty() && !tiled) {
+    cerr << "--tile-report needs --tile." << endl;
+    return EXIT_FAILURE;
+  }
+
   // If reach here, all input argv are valid.
   // cout << "The block size is: " << block_size << endl;
 
   // Construct a BitMap object using the input file specified
 
   // Load image and prepare for processing
-  BitMap image(input_fname);
+  BitMap image(input_fname, BitMap::LoadMode::kMap);
   if (image.check_error() != BMP_OK) {
     perror("ERROR: Failed to open BMP file.");
     return EXIT_FAILURE;
@@ -99,31 +164,40 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  // Calculate workload per thread (by rows)
-  int rowsPerThread = height / thread_count;
-  int extraRows = height % thread_count;
-
-  vector<thread> threads;
-
-  int currentStartY = 0;
-  for (int i = 0; i < thread_count; ++i) {
-    int rowsForThisThread = rowsPerThread + (i < extraRows ? 1 : 0);
-    int endY = currentStartY + rowsForThisThread - 1;
+  // The workers are shared by every pass below, and idle workers steal
+  // sections from busy ones, so rows near the image edges that are cheaper
+  // to blur do not leave threads waiting
+  ThreadPool pool(thread_count);
 
-    // Log the section of the image assigned to each thread
-    cout << "Thread " << i + 1 << " processing rows " << currentStartY << " to "
-         << endY << endl;
-
-    // Spawn a thread to process a section of the image
-    threads.emplace_back(processSection, 0, currentStartY, width - 1, endY,
-                         ref(image), ref(blur), block_size);
-
-    currentStartY += rowsForThisThread;
-  }
-
-  // Wait for all threads to complete
-  for (auto& th : threads) {
-    th.join();
+  if (tiled) {
+    // Each tile is blurred independently from its own halo, so tiles need
+    // no synchronization between them
+    vector<Tile> tiles = make_tiles(width, height, tileWidth, tileHeight);
+    cout << "Blurring " << tiles.size() << " tiles of " << tileWidth << "x"
+         << tileHeight << " on " << thread_count << " threads" << endl;
+    vector<TileTiming> timings =
+        blurTiles(pool, image, blur, block_size, tiles);
+    reportTiles(tiles, timings, tileReport);
+  } else if (mode == BlurMode::kSeparable) {
+    // Every row must have its horizontal sums before any column is summed,
+    // so the two passes are separate parallel loops.
+    SeparableBlur separable(width, height, block_size);
+    forEachSection(pool, height, [&](int start, int end) {
+      separable.horizontal_pass(image, start, end);
+    });
+    forEachSection(pool, width, [&](int start, int end) {
+      separable.vertical_pass(blur, start, end);
+    });
+  } else if (mode == BlurMode::kSummedArea) {
+    // The table is built once up front and shared read-only by all threads
+    SummedAreaTable table(image);
+    forEachSection(pool, height, [&](int start, int end) {
+      table.blur_rows(blur, block_size, start, end);
+    });
+  } else {
+    forEachSection(pool, height, [&](int start, int end) {
+      blur_rows_naive(image, blur, block_size, start, end);
+    });
   }
 
   // Output the blurred image to disk
@@ -136,50 +210,78 @@ int main(int argc, char* argv[]) {
   return EXIT_SUCCESS;
 }
 
-// Process a section of the image within the specified bounds: from (startX,
-// startY) to (endX, endY) Loop through each pixel and calcute its block average
-void processSection(int startX,
-                    int startY,
-                    int endX,
-                    int endY,
-                    BitMap& image,
-                    BitMap& blur,
-                    int block_size) {
-  // Iterate over each row in the section assigned to this thread
-  for (int y = startY; y <= endY; ++y) {
-    // startX and endX now represent the full width of the image for each row
-    for (int x = startX; x <= endX; ++x) {
-      size_t pixels_counter = 0;
-      unsigned int total_red = 0, total_green = 0, total_blue = 0;
-
-      // Calculate the neighborhood boundaries considering the block size
-      int neighborStartY = max(0, y - block_size);
-      int neighborEndY = min(y + block_size, static_cast<int>(height) - 1);
-      int neighborStartX = max(0, x - block_size);
-      int neighborEndX = min(x + block_size, static_cast<int>(width) - 1);
-
-      // Sum up the color values of all neighboring pixels
-      for (int yy = neighborStartY; yy <= neighborEndY; ++yy) {
-        for (int xx = neighborStartX; xx <= neighborEndX; ++xx) {
-          RGB color = image.get_pixel(xx, yy);
-          total_red += color.red;
-          total_green += color.green;
-          total_blue += color.blue;
-          ++pixels_counter;
-        }
-      }
+template <typename Function>
+void forEachSection(ThreadPool& pool, UINT count, Function process) {
+  pool.parallel_for(0, count, 0, [&](size_t start, size_t end) {
+    process(start, end - 1);
+  });
+}
 
-      // Avoid division by zero
-      if (pixels_counter == 0)
-        continue;
+bool parseTileSize(const string& value, UINT& tileWidth, UINT& tileHeight) {
+  size_t split = value.find('x');
+  string widthStr = value.substr(0, split);
+  string heightStr = split == string::npos ? widthStr : value.substr(split + 1);
+  try {
+    size_t widthPos, heightPos;
+    long w = stol(widthStr, &widthPos);
+    long h = stol(heightStr, &heightPos);
+    if (widthPos != widthStr.length() || heightPos != heightStr.length() ||
+        w <= 0 || h <= 0) {
+      return false;
+    }
+    tileWidth = w;
+    tileHeight = h;
+  } catch (const std::logic_error& e) {
+    return false;
+  }
+  return true;
+}
 
-      // Calculate the average color of the block
-      RGB average_color = {static_cast<UCHAR>(total_red / pixels_counter),
-                           static_cast<UCHAR>(total_green / pixels_counter),
-                           static_cast<UCHAR>(total_blue / pixels_counter)};
+vector<TileTiming> blurTiles(ThreadPool& pool,
+                             BitMap& image,
+                             BitMap& blur,
+                             int block_size,
+                             const vector<Tile>& tiles) {
+  vector<TileTiming> timings(tiles.size());
+  vector<vector<uint32_t>> scratch(pool.size());
 
-      // Set the pixel color on the blur image
-      blur.set_pixel(x, y, average_color);
-    }
+  // Each tile's timing is written only by the worker that ran it, so the
+  // vector needs no lock
+  pool.parallel_for(0, tiles.size(), 1, [&](size_t i, size_t) {
+    int worker = ThreadPool::current_worker();
+    auto start = chrono::steady_clock::now();
+    blur_tile(image, blur, block_size, tiles[i], scratch[worker]);
+    auto elapsed = chrono::steady_clock::now() - start;
+    timings[i] = TileTiming{
+        worker,
+        static_cast<long>(
+            chrono::duration_cast<chrono::microseconds>(elapsed).count())};
+  });
+  return timings;
+}
+
+void reportTiles(const vector<Tile>& tiles,
+                 const vector<TileTiming>& timings,
+                 const string& reportFile) {
+  vector<long> micros;
+  for (const TileTiming& timing : timings) {
+    micros.push_back(timing.micros);
+  }
+  sort(micros.begin(), micros.end());
+  long total = accumulate(micros.begin(), micros.end(), 0L);
+
+  cout << "Tile time (us): min " << micros.front() << ", median "
+       << micros[micros.size() / 2] << ", mean " << total / micros.size()
+       << ", max " << micros.back() << ", total " << total << endl;
+
+  if (reportFile.empty()) {
+    return;
+  }
+  ofstream out(reportFile);
+  out << "tile,x0,y0,x1,y1,worker,micros\n";
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    out << i << ',' << tiles[i].x0 << ',' << tiles[i].y0 << ','
+        << tiles[i].x1 << ',' << tiles[i].y1 << ',' << timings[i].worker
+        << ',' << timings[i].micros << '\n';
   }
 }
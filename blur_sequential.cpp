@@ -1,25 +1,23 @@
-#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include "BoxBlur.hpp"
 #include "qdbmp.hpp"
 
 using std::cerr;
 using std::cout;
 using std::endl;
-using std::max;
-using std::min;
+using std::optional;
 using std::string;
 
-constexpr UCHAR MAX_COLOR_VALUE = 255U;
 unsigned int height;
 unsigned int width;
 
 int main(int argc, char* argv[]) {
   // Check input commands
-  if (argc != 4) {
+  if (argc != 4 && argc != 5) {
     cerr << "Usage: " << argv[0] << " <input file> <output_file> <block_size>"
-         << endl;
+         << " [--mode=auto|naive|sat|separable]" << endl;
     return EXIT_FAILURE;
   }
 
@@ -50,11 +48,25 @@ int main(int argc, char* argv[]) {
     cerr << "The argument is out of integer range." << endl;
     return EXIT_FAILURE;
   }
+
+  // Check the optional blur mode
+  BlurMode mode = BlurMode::kAuto;
+  if (argc == 5) {
+    optional<BlurMode> parsed = parse_blur_mode(argv[4]);
+    if (!parsed) {
+      cerr << "The blur mode should be one of "
+           << "--mode=auto|naive|sat|separable." << endl;
+      return EXIT_FAILURE;
+    }
+    mode = *parsed;
+  }
+  mode = resolve_blur_mode(mode, block_size);
+
   // If reach here, all input argv are valid.
   // cout << "The block size is: " << block_size << endl;
 
   // Construct a BitMap object using the input file specified
-  BitMap image(input_fname);
+  BitMap image(input_fname, BitMap::LoadMode::kMap);
 
   // Check the command above succeed
   if (image.check_error() != BMP_OK) {
@@ -73,50 +85,23 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  // Loop through each pixel and calcute its block average
-  for (size_t y = 0; y < height; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      size_t pixels_counter = 0;
-      unsigned int total_red = 0, total_green = 0, total_blue = 0;
-
-      size_t startY = max(0, static_cast<int>(y) - block_size);
-      size_t endY = min(y + block_size, static_cast<size_t>(height - 1));
-      size_t startX = max(0, static_cast<int>(x) - block_size);
-      size_t endX = min(x + block_size, static_cast<size_t>(width - 1));
-
-      for (size_t yyy = startY; yyy <= endY; ++yyy) {
-        for (size_t xxx = startX; xxx <= endX; ++xxx) {
-          ++pixels_counter;
-          RGB color = image.get_pixel(xxx, yyy);
-          total_red += color.red;
-          total_green += color.green;
-          total_blue += color.blue;
-        }
-      }
-
-      if (pixels_counter == 0) {
-        continue;
-      }
-
-      // Debug output - casting to ensure numerical output
-      // cout << "Accumulated Colors for (" << x << ", " << y
-      //      << "): Red=" << static_cast<unsigned int>(total_red)
-      //      << ", Green=" << static_cast<unsigned int>(total_green)
-      //      << ", Blue=" << static_cast<unsigned int>(total_blue)
-      //      << ", Counter=" << pixels_counter << endl;
-
-      RGB average_color = {static_cast<UCHAR>(total_red / pixels_counter),
-                           static_cast<UCHAR>(total_green / pixels_counter),
-                           static_cast<UCHAR>(total_blue / pixels_counter)};
-      blur.set_pixel(x, y, average_color);
-    }
+  // Calculate the block average of every pixel
+  if (mode == BlurMode::kSummedArea) {
+    SummedAreaTable table(image);
+    table.blur_rows(blur, block_size, 0, height - 1);
+  } else if (mode == BlurMode::kSeparable) {
+    SeparableBlur separable(width, height, block_size);
+    separable.horizontal_pass(image, 0, height - 1);
+    separable.vertical_pass(blur, 0, width - 1);
+  } else {
+    blur_rows_naive(image, blur, block_size, 0, height - 1);
   }
 
   // Output the negative image to disk
   blur.write_file(output_fname);
 
-  if (image.check_error() != BMP_OK) {
-    perror("ERROR: Failed to open BMP file.");
+  if (blur.check_error() != BMP_OK) {
+    perror("ERROR: Failed to write BMP file.");
     return EXIT_FAILURE;
   }
 
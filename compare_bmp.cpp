@@ -7,45 +7,402 @@
 **************************************************************/
 
 #include "qdbmp.hpp"
+#include "BmpCompare.hpp"
+#include "BatchCompare.hpp"
+#include "ImageQuality.hpp"
+#include "ThreadPool.hpp"
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
 
 using std::ofstream;
+using std::ostream;
 using std::cerr;
 using std::cout;
 using std::endl;
+using std::string;
+using std::vector;
 
-/* Creates a negative image of the input bitmap file */
+/* Exit status of the pass/fail and batch modes */
+static const int kExitPass = 0;
+static const int kExitFail = 1;
+static const int kExitError = 2;
+
+/* What the command line asked for */
+struct Options {
+  unsigned long	thread_count = 0;
+  bool	identical = false;
+  bool	gate = false;  /* any of --identical, --max-diff or --max-pct */
+  bool	has_max_incorrect = false;
+  unsigned long	max_incorrect = 0;
+  bool	has_max_incorrect_pct = false;
+  double	max_incorrect_pct = 0;
+  bool	batch = false;  /* --batch or --manifest */
+  string	batch_dir1, batch_dir2;  /* --batch <dir1> <dir2> */
+  string	manifest;                /* --manifest=<file> */
+  bool	json = false;            /* --format=json rather than csv */
+  bool	metrics = false;         /* --metrics */
+  unsigned long	ssim_window = kDefaultSsimWindow;
+  string	diff_image;              /* --diff-image=<file> */
+  DiffStyle	diff_style = DiffStyle::kAbsolute;
+  unsigned long	diff_gain = kDefaultDiffGain;
+  vector<string>	files;
+};
+
+/* Parses the whole of text as a count, returning false if it is not one */
+static bool parse_count( const string& text, unsigned long& count )
+{
+  size_t pos = 0;
+  try {
+    count = std::stoul( text, &pos );
+  } catch ( const std::logic_error& e ) {
+    return false;
+  }
+  return pos != 0 && pos == text.length() && text[ 0 ] != '-';
+}
+
+/* Parses the whole of text as a percentage from 0 to 100 */
+static bool parse_percent( const string& text, double& pct )
+{
+  size_t pos = 0;
+  try {
+    pct = std::stod( text, &pos );
+  } catch ( const std::logic_error& e ) {
+    return false;
+  }
+  return pos != 0 && pos == text.length() && pct >= 0 && pct <= 100;
+}
+
+static void usage( const char* program )
+{
+  cerr << "Usage: " << program << " <bmp file #1> <bmp file #2> <results file>?"
+       << " [--threads=N] [--identical] [--max-diff=N] [--max-pct=P]" << endl;
+  cerr << "       " << program << " --batch <dir #1> <dir #2> [options]" << endl;
+  cerr << "       " << program << " --manifest=<file> [options]" << endl;
+  cerr << "  --identical     pass only if both images have the same size and pixels" << endl;
+  cerr << "  --max-diff=N    pass if at most N pixels differ" << endl;
+  cerr << "  --max-pct=P     pass if at most P percent of the pixels differ" << endl;
+  cerr << "  --batch         compare each .bmp in dir #1 with the one of the same name in dir #2" << endl;
+  cerr << "  --manifest      compare the pairs of paths listed one pair per line in file" << endl;
+  cerr << "  --format=F      batch output: csv (default) or json, one line per pair and a summary" << endl;
+  cerr << "  --metrics       also report MSE, PSNR, the largest channel error and SSIM" << endl;
+  cerr << "  --ssim-window=N side of the SSIM window, from 1 to " << kMaxSsimWindow
+       << " (default " << kDefaultSsimWindow << ")" << endl;
+  cerr << "  --diff-image=F  write where the images differ to the bmp file F and list" << endl;
+  cerr << "                  the boxes around the differing regions" << endl;
+  cerr << "  --diff-style=S  abs (default): each channel's difference times the gain;" << endl;
+  cerr << "                  mask: red where pixels differ, green where they match" << endl;
+  cerr << "  --diff-gain=G   gain of the abs style, from 1 to 255 (default "
+       << kDefaultDiffGain << ")" << endl;
+  cerr << "With one of the first three, or in batch mode, the exit status is "
+       << kExitPass << " if every pair passes, " << kExitFail << " if one fails and "
+       << kExitError << " on errors. A batch pair passes if it is identical "
+       << "unless --max-diff or --max-pct is given." << endl;
+}
+
+/* Fills opts from the command line, returning false if it is malformed */
+static bool parse_options( int argc, char* argv[], Options& opts )
+{
+  string bad_option;
+  for ( int i = 1; i < argc; i++ ) {
+    string arg = argv[ i ];
+    bool ok = true;
+    if ( arg.rfind( "--threads=", 0 ) == 0 ) {
+      ok = parse_count( arg.substr( 10 ), opts.thread_count );
+    } else if ( arg == "--identical" ) {
+      opts.identical = opts.gate = true;
+    } else if ( arg.rfind( "--max-diff=", 0 ) == 0 ) {
+      ok = parse_count( arg.substr( 11 ), opts.max_incorrect );
+      opts.has_max_incorrect = opts.gate = true;
+    } else if ( arg.rfind( "--max-pct=", 0 ) == 0 ) {
+      ok = parse_percent( arg.substr( 10 ), opts.max_incorrect_pct );
+      opts.has_max_incorrect_pct = opts.gate = true;
+    } else if ( arg == "--batch" ) {
+      ok = i + 2 < argc;
+      if ( ok ) {
+        opts.batch_dir1 = argv[ ++i ];
+        opts.batch_dir2 = argv[ ++i ];
+      }
+      opts.batch = true;
+    } else if ( arg.rfind( "--manifest=", 0 ) == 0 ) {
+      opts.manifest = arg.substr( 11 );
+      ok = !opts.manifest.empty();
+      opts.batch = true;
+    } else if ( arg == "--format=csv" || arg == "--format=json" ) {
+      opts.json = arg == "--format=json";
+    } else if ( arg == "--metrics" ) {
+      opts.metrics = true;
+    } else if ( arg.rfind( "--ssim-window=", 0 ) == 0 ) {
+      ok = parse_count( arg.substr( 14 ), opts.ssim_window ) &&
+           opts.ssim_window >= 1 && opts.ssim_window <= kMaxSsimWindow;
+    } else if ( arg.rfind( "--diff-image=", 0 ) == 0 ) {
+      opts.diff_image = arg.substr( 13 );
+      ok = !opts.diff_image.empty();
+    } else if ( arg == "--diff-style=abs" || arg == "--diff-style=mask" ) {
+      opts.diff_style = arg == "--diff-style=mask" ? DiffStyle::kMask
+                                                  : DiffStyle::kAbsolute;
+    } else if ( arg.rfind( "--diff-gain=", 0 ) == 0 ) {
+      ok = parse_count( arg.substr( 12 ), opts.diff_gain ) &&
+           opts.diff_gain >= 1 && opts.diff_gain <= 255;
+    } else if ( arg.rfind( "--", 0 ) == 0 ) {
+      ok = false;
+    } else {
+      opts.files.push_back( arg );
+    }
+    if ( !ok && bad_option.empty() ) {
+      bad_option = arg;
+    }
+  }
+  if ( !bad_option.empty() ) {
+    cerr << "Bad option " << bad_option << endl;
+    return false;
+  }
+  /* A diff image needs every pixel of a single pair */
+  if ( !opts.diff_image.empty() && ( opts.gate || opts.batch ) ) {
+    cerr << "--diff-image only works when comparing a single pair in full" << endl;
+    return false;
+  }
+  if ( opts.batch ) {
+    return opts.files.empty() && ( opts.batch_dir1.empty() || opts.manifest.empty() );
+  }
+  return opts.files.size() == 2 || opts.files.size() == 3;
+}
+
+/* Returns the most incorrect pixels --max-diff and --max-pct allow in an
+   image of the given number of pixels */
+static long incorrect_limit( const Options& opts, long pixels )
+{
+  long limit = pixels;
+  if ( opts.has_max_incorrect ) {
+    limit = std::min( limit, (long)std::min<unsigned long>( opts.max_incorrect, pixels ) );
+  }
+  if ( opts.has_max_incorrect_pct ) {
+    limit = std::min( limit, (long)( opts.max_incorrect_pct / 100 * pixels ) );
+  }
+  return limit;
+}
+
+/* Writes text as a CSV field, quoted if it needs to be */
+static void write_csv_field( ostream& out, const string& text )
+{
+  if ( text.find_first_of( ",\"\n" ) == string::npos ) {
+    out << text;
+    return;
+  }
+  out << '"';
+  for ( char c : text ) {
+    out << ( c == '"' ? "\"\"" : string( 1, c ) );
+  }
+  out << '"';
+}
+
+/* Writes text as a JSON string */
+static void write_json_string( ostream& out, const string& text )
+{
+  out << '"';
+  for ( unsigned char c : text ) {
+    if ( c == '"' || c == '\\' ) {
+      out << '\\' << c;
+    } else if ( c < 0x20 ) {
+      char escape[ 8 ];
+      snprintf( escape, sizeof( escape ), "\\u%04x", c );
+      out << escape;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+/* Returns the percentages of the report, or 0 where there is nothing to
+   divide by, since batch output must stay machine readable */
+static double pct_of( double part, double whole )
+{
+  return whole == 0 ? 0 : 100 * part / whole;
+}
+
+/* Compares every pair of the batch, writing one line per pair and a
+   summary line to cout, and returns the exit status */
+static int run_batch( const Options& opts )
+{
+  vector<ImagePair> pairs;
+  string error;
+  bool listed = opts.manifest.empty()
+      ? pairs_in_directories( opts.batch_dir1, opts.batch_dir2, pairs, error )
+      : pairs_in_manifest( opts.manifest, pairs, error );
+  if ( !listed ) {
+    cerr << error << endl;
+    return kExitError;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  long passed = 0, failed = 0, errors = 0;
+  long correct_pixels = 0, incorrect_pixels = 0;
+  std::ostringstream line;
+  line << std::setprecision( 4 ) << std::fixed;
+  if ( !opts.json ) {
+    cout << "file1,file2,status,width,height,same_size,correct_pixels,"
+            "incorrect_pixels,pct_incorrect,pct_diff,";
+    cout << ( opts.metrics ? "mse,psnr,max_error,ssim,error" : "error" ) << '\n';
+  }
+
+  BatchSettings settings;
+  settings.measure = opts.metrics;
+  settings.ssim_window = opts.ssim_window;
+  ThreadPool pool( opts.thread_count );
+  compare_batch( pairs, pool, settings, [&]( const PairResult& result ) {
+    const CompareTotals& totals = result.totals;
+    const long pixels = totals.correct_pixels + totals.incorrect_pixels;
+    const bool same_size = result.width1 == result.width2 &&
+                           result.height1 == result.height2;
+    string status;
+    if ( !result.error.empty() ) {
+      status = "error";
+      errors++;
+    } else if ( opts.has_max_incorrect || opts.has_max_incorrect_pct
+                    ? totals.incorrect_pixels <= incorrect_limit( opts, pixels )
+                    : same_size && totals.incorrect_pixels == 0 ) {
+      status = "pass";
+      passed++;
+    } else {
+      status = "fail";
+      failed++;
+    }
+    correct_pixels += totals.correct_pixels;
+    incorrect_pixels += totals.incorrect_pixels;
+    const double pct_incorrect = pct_of( totals.incorrect_pixels, pixels );
+    const double pct_diff = pct_of( totals.diff, 255.0 * totals.incorrect_pixels );
+
+    line.str( "" );
+    if ( opts.json ) {
+      line << "{\"file1\":";
+      write_json_string( line, result.pair->file1 );
+      line << ",\"file2\":";
+      write_json_string( line, result.pair->file2 );
+      line << ",\"status\":\"" << status << '"';
+      if ( result.error.empty() ) {
+        line << ",\"width\":" << result.width1 << ",\"height\":" << result.height1
+             << ",\"same_size\":" << ( same_size ? "true" : "false" )
+             << ",\"correct_pixels\":" << totals.correct_pixels
+             << ",\"incorrect_pixels\":" << totals.incorrect_pixels
+             << ",\"pct_incorrect\":" << pct_incorrect
+             << ",\"pct_diff\":" << pct_diff;
+        if ( opts.metrics ) {
+          const QualityMetrics& quality = result.quality;
+          line << ",\"mse\":" << quality.mse << ",\"psnr\":";
+          /* JSON has no infinity; identical images get a null PSNR */
+          if ( std::isinf( quality.psnr ) ) {
+            line << "null";
+          } else {
+            line << quality.psnr;
+          }
+          line << ",\"max_error\":" << quality.max_error
+               << ",\"ssim\":" << std::setprecision( 6 ) << quality.ssim
+               << std::setprecision( 4 );
+        }
+      } else {
+        line << ",\"error\":";
+        write_json_string( line, result.error );
+      }
+      line << '}';
+    } else {
+      write_csv_field( line, result.pair->file1 );
+      line << ',';
+      write_csv_field( line, result.pair->file2 );
+      line << ',' << status << ',';
+      if ( result.error.empty() ) {
+        line << result.width1 << ',' << result.height1 << ','
+             << ( same_size ? "true" : "false" ) << ','
+             << totals.correct_pixels << ',' << totals.incorrect_pixels << ','
+             << pct_incorrect << ',' << pct_diff << ',';
+        if ( opts.metrics ) {
+          const QualityMetrics& quality = result.quality;
+          line << quality.mse << ',' << quality.psnr << ',' << quality.max_error
+               << ',' << std::setprecision( 6 ) << quality.ssim
+               << std::setprecision( 4 ) << ',';
+        }
+      } else {
+        line << ( opts.metrics ? ",,,,,,,,,,," : ",,,,,,," );
+        write_csv_field( line, result.error );
+      }
+    }
+    /* Flushed per pair, so that a long batch can be followed as it runs */
+    cout << line.str() << endl;
+  } );
+
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+  const double pct_incorrect = pct_of( incorrect_pixels, correct_pixels + incorrect_pixels );
+  cout << std::setprecision( 4 ) << std::fixed;
+  if ( opts.json ) {
+    cout << "{\"summary\":{\"pairs\":" << pairs.size() << ",\"passed\":" << passed
+         << ",\"failed\":" << failed << ",\"errors\":" << errors
+         << ",\"correct_pixels\":" << correct_pixels
+         << ",\"incorrect_pixels\":" << incorrect_pixels
+         << ",\"pct_incorrect\":" << pct_incorrect
+         << ",\"seconds\":" << seconds.count() << "}}" << endl;
+  } else {
+    cout << "# summary: pairs=" << pairs.size() << " passed=" << passed
+         << " failed=" << failed << " errors=" << errors
+         << " correct_pixels=" << correct_pixels
+         << " incorrect_pixels=" << incorrect_pixels
+         << " pct_incorrect=" << pct_incorrect
+         << " seconds=" << seconds.count() << endl;
+  }
+
+  if ( errors > 0 ) {
+    return kExitError;
+  }
+  return failed > 0 ? kExitFail : kExitPass;
+}
+
+/* Compares two bitmap files pixel by pixel */
 int main( int argc, char* argv[] )
 {
-  UCHAR	r1, g1, b1, r2, g2, b2;
   UINT	width1, height1, width2, height2;
-  UINT	x, y;
-  BMP*	bmp1;
-  BMP*    bmp2;
-  
+  Options	opts;
+
+  /* Options may appear anywhere; --threads=N picks the number of workers,
+     0 uses every hardware thread */
+  bool parsed = parse_options( argc, argv, opts );
+  const int error_status = opts.gate || opts.batch ? kExitError : -1;
+
   /* Check arguments */
-  if ( argc != 3 && argc != 4 ) {
-      cerr << "Usage: " << argv[0] << " <bmp file #1> <bmp file #2> <results file>?" << endl;
-      return EXIT_FAILURE;
+  if ( !parsed ) {
+      usage( argv[ 0 ] );
+      return opts.gate || opts.batch ? kExitError : EXIT_FAILURE;
   }
-  
+  if ( opts.batch ) {
+    return run_batch( opts );
+  }
+
   /* Read the first image file */
-  bmp1 = BMP_ReadFile( argv[ 1 ] );
-  BMP_CHECK_ERROR( stdout, -1 );
+  BitMap bmp1( opts.files[ 0 ], BitMap::LoadMode::kMap );
+  if ( bmp1.check_error() != BMP_OK ) {
+    printf( "BMP error: %s\n", bmp1.error_description() );
+    return error_status;
+  }
   /* Read the second image file */
-  bmp2 = BMP_ReadFile( argv[ 2 ] );
-  BMP_CHECK_ERROR( stdout, -1 );
-  
+  BitMap bmp2( opts.files[ 1 ], BitMap::LoadMode::kMap );
+  if ( bmp2.check_error() != BMP_OK ) {
+    printf( "BMP error: %s\n", bmp2.error_description() );
+    return error_status;
+  }
+
   /* Get each image's dimensions */
-  width1 = BMP_GetWidth( bmp1 );
-  height1 = BMP_GetHeight( bmp1 );
-  width2 = BMP_GetWidth( bmp2 );
-  height2 = BMP_GetHeight( bmp2 );
-  
+  width1 = bmp1.width();
+  height1 = bmp1.height();
+  width2 = bmp2.width();
+  height2 = bmp2.height();
+
   // if the size is different, that's bad
   if (width1 != width2) {
     printf("WIDTH IS DIFFERENT\n");
@@ -54,67 +411,111 @@ int main( int argc, char* argv[] )
     printf("HEIGHT IS DIFFERENT\n");
   }
 
-  long diff = 0;
-  int correct_pixels = 0;
-  int incorrect_pixels = 0;
-
-  
-  /* Iterate through all the image's pixels */
-  for ( x = 0 ; x < width1 ; ++x ) {
-   
-    for ( y = 0 ; y < height1 ; ++y ) {
-      /* Get pixel's RGB values from first image */
-      BMP_GetPixelRGB( bmp1, x, y, &r1, &g1, &b1 );
-      /* Get pixel's RGB values from second image */
-      BMP_GetPixelRGB( bmp2, x, y, &r2, &g2, &b2 );
+  ThreadPool pool( opts.thread_count );
 
-      if (r1 == r2 && g1 == g2 && b1 == b2) {
-	correct_pixels++;
-      }
-      else {
-	incorrect_pixels++;
-      }
+  /* In the pass/fail modes, only the verdict is needed, so the comparison
+     stops as soon as it is known */
+  if ( opts.gate ) {
+    string verdict;
+    bool pass;
+    if ( opts.identical ) {
+      pass = images_identical( bmp1, bmp2, pool );
+      verdict = pass ? "Images are identical" : "Images differ";
+    } else {
+      long limit = incorrect_limit( opts, (long)width1 * height1 );
+      pass = images_within_tolerance( bmp1, bmp2, limit, pool );
+      verdict = string( pass ? "Within" : "Over" ) + " tolerance of " +
+                std::to_string( limit ) + " incorrect pixels";
+    }
+    if ( opts.files.size() == 2 ) {
+      cout << verdict << endl;
+    } else {
+      ofstream out( opts.files[ 2 ] );
+      out << verdict << endl;
+    }
+    return pass ? kExitPass : kExitFail;
+  }
 
-      if (r1 != r2) {
-	//printf("RED IS OFF BY %d\n", abs(r1-r2));
-	diff += abs(r1-r2);
-      }
-      if (g1 != g2) {
-	//printf("GREEN IS OFF BY %d\n", abs(g1-g2));
-	diff += abs(g1-g2);
-      }
-      if (b1 != b2) {
-	//printf("BLUE IS OFF BY %d\n", abs(b1-b2));
-	diff += abs(b1-b2);
-      }
-      
+  /* Compare both images row by row, with the rows split between the
+     workers, drawing the differences in the same pass if asked to */
+  DiffOutput regions;
+  std::unique_ptr<BitMap> diff_bmp;
+  if ( !opts.diff_image.empty() ) {
+    diff_bmp = std::make_unique<BitMap>( width1, height1 );
+    if ( diff_bmp->check_error() != BMP_OK ) {
+      printf( "BMP error: %s\n", diff_bmp->error_description() );
+      return error_status;
     }
+    regions.image = diff_bmp.get();
+    regions.style = opts.diff_style;
+    regions.gain = opts.diff_gain;
   }
+  CompareTotals totals = compare_images( bmp1, bmp2, pool,
+                                         diff_bmp ? &regions : nullptr );
+  if ( diff_bmp ) {
+    diff_bmp->write_file( opts.diff_image );
+    if ( diff_bmp->check_error() != BMP_OK ) {
+      printf( "BMP error: %s\n", diff_bmp->error_description() );
+      return error_status;
+    }
+  }
+  long diff = totals.diff;
+  long correct_pixels = totals.correct_pixels;
+  long incorrect_pixels = totals.incorrect_pixels;
 
   float pct_incorrect = 100 * incorrect_pixels / (float)(correct_pixels + incorrect_pixels);
   long max_diff = 255 * incorrect_pixels;
   float pct_diff = 100 * diff / (float)max_diff;
 
-  if (argc == 3) {
+  /* The quality metrics are a second pass, only made when asked for */
+  QualityMetrics quality;
+  if ( opts.metrics ) {
+    quality = measure_quality( bmp1, bmp2, pool, opts.ssim_window );
+  }
+
+  if (opts.files.size() == 2) {
     cout << "============================================" << endl;
     cout << "Correct pixels is " << correct_pixels << endl;
     cout << "Incorrect pixels is " << incorrect_pixels << endl;
     cout << std::setprecision(4) << std::fixed;
     cout << "Pct incorrect is " << pct_incorrect << endl;
     cout << "Pct diff is " << pct_diff << endl;
+    if ( opts.metrics ) {
+      cout << "MSE is " << quality.mse << endl;
+      cout << "PSNR is " << quality.psnr << " dB" << endl;
+      cout << "Max channel error is " << quality.max_error << endl;
+      cout << "SSIM is " << std::setprecision( 6 ) << quality.ssim << endl;
+    }
+    if ( diff_bmp ) {
+      cout << "Diff regions is " << regions.boxes.size() << endl;
+      for ( const DiffBox& box : regions.boxes ) {
+        cout << "  at " << box.x << "," << box.y << " size " << box.width << "x"
+             << box.height << ", " << box.pixels << " pixels differ" << endl;
+      }
+    }
     cout << "============================================" << endl;
-  } else {  // argc == 4
-    ofstream out(argv[3]);
+  } else {  // a results file was given
+    ofstream out(opts.files[2]);
     out << std::setprecision(4) << std::fixed;
     out << "Correct Pixels: " << correct_pixels << '\n';
     out << "Incorrect pixels: " << incorrect_pixels << '\n';
     out << "Incorrect Pct: " << pct_incorrect << '\n';
     out << "Pct Diff: " << pct_diff << endl;
+    if ( opts.metrics ) {
+      out << "MSE: " << quality.mse << '\n';
+      out << "PSNR: " << quality.psnr << '\n';
+      out << "Max Channel Error: " << quality.max_error << '\n';
+      out << "SSIM: " << std::setprecision( 6 ) << quality.ssim << endl;
+    }
+    if ( diff_bmp ) {
+      out << "Diff Regions: " << regions.boxes.size() << '\n';
+      for ( const DiffBox& box : regions.boxes ) {
+        out << "Region: " << box.x << ' ' << box.y << ' ' << box.width << ' '
+            << box.height << ' ' << box.pixels << '\n';
+      }
+      out.flush();
+    }
   }
-  
-  /* Free all memory allocated for the image */
-  BMP_Free( bmp1 );
-  BMP_Free( bmp2 );
-  
+
   return 0;
 }
@@ -1,6 +1,15 @@
+/* Needed for the POSIX file calls under a strict -std=c2x build */
+#define _POSIX_C_SOURCE 200809L
+
 #include "cqdbmp.h"
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 
 /* Bitmap header */
@@ -31,11 +40,14 @@ struct _BMP
 	BMP_Header	Header;
 	UCHAR*		Palette;
 	UCHAR*		Data;
+	UCHAR*		MapBase;	/* Start of the file mapping if read by BMP_MapFile, NULL otherwise */
+	size_t		MapLength;	/* Length of the file mapping */
 };
 
 
-/* Holds the last error code */
-static BMP_STATUS BMP_LAST_ERROR_CODE = 0;
+/* Holds the last error code. Each thread has its own copy, so concurrent
+   operations on different images never overwrite each other's status. */
+static _Thread_local BMP_STATUS BMP_LAST_ERROR_CODE = 0;
 
 
 /* Error description strings */
@@ -57,16 +69,25 @@ static const char* BMP_ERROR_STRING[] =
 #define BMP_PALETTE_SIZE	( 256 * 4 )
 
 
+/* Size of the file header plus the info header */
+#define BMP_HEADER_SIZE		54
+
+
 
 /*********************************** Forward declarations **********************************/
 int		ReadHeader	( BMP* bmp, FILE* f );
-int		WriteHeader	( BMP* bmp, FILE* f );
+int		RowsFitData	( BMP* bmp );
+
+void	DecodeHeader	( BMP* bmp, const UCHAR* buffer );
+void	EncodeHeader	( BMP* bmp, UCHAR* buffer );
 
-int		ReadUINT	( UINT* x, FILE* f );
-int		ReadUSHORT	( USHORT *x, FILE* f );
+UINT	DecodeUINT		( const UCHAR* buffer );
+USHORT	DecodeUSHORT	( const UCHAR* buffer );
 
-int		WriteUINT	( UINT x, FILE* f );
-int		WriteUSHORT	( USHORT x, FILE* f );
+void	EncodeUINT		( UINT x, UCHAR* buffer );
+void	EncodeUSHORT	( USHORT x, UCHAR* buffer );
+
+int		WriteAll		( int fd, struct iovec* iov, int count );
 
 
 
@@ -81,21 +102,41 @@ int		WriteUSHORT	( USHORT x, FILE* f );
 	and bit depth.
 **************************************************************/
 BMP* BMP_Create( UINT width, UINT height, USHORT depth )
+{
+	BMP*	bmp;
+
+	BMP_LAST_ERROR_CODE = BMP_CreateEx( width, height, depth, &bmp );
+
+	return bmp;
+}
+
+
+/**************************************************************
+	Creates a blank BMP image with the specified dimensions
+	and bit depth into *out. Returns the operation's status
+	instead of recording it as the last error code.
+**************************************************************/
+BMP_STATUS BMP_CreateEx( UINT width, UINT height, USHORT depth, BMP** out )
 {
 	BMP*	bmp;
 	int		bytes_per_pixel = depth >> 3;
 	UINT	bytes_per_row;
 
+	if ( out == NULL )
+	{
+		return BMP_INVALID_ARGUMENT;
+	}
+
+	*out = NULL;
+
 	if ( height <= 0 || width <= 0 )
 	{
-		BMP_LAST_ERROR_CODE = BMP_INVALID_ARGUMENT;
-		return NULL;
+		return BMP_INVALID_ARGUMENT;
 	}
 
 	if ( depth != 8 && depth != 24 && depth != 32 )
 	{
-		BMP_LAST_ERROR_CODE = BMP_FILE_NOT_SUPPORTED;
-		return NULL;
+		return BMP_FILE_NOT_SUPPORTED;
 	}
 
 
@@ -103,8 +144,7 @@ BMP* BMP_Create( UINT width, UINT height, USHORT depth )
 	bmp = calloc( 1, sizeof( BMP ) );
 	if ( bmp == NULL )
 	{
-		BMP_LAST_ERROR_CODE = BMP_OUT_OF_MEMORY;
-		return NULL;
+		return BMP_OUT_OF_MEMORY;
 	}
 
 
@@ -142,9 +182,8 @@ BMP* BMP_Create( UINT width, UINT height, USHORT depth )
 		bmp->Palette = (UCHAR*) calloc( BMP_PALETTE_SIZE, sizeof( UCHAR ) );
 		if ( bmp->Palette == NULL )
 		{
-			BMP_LAST_ERROR_CODE = BMP_OUT_OF_MEMORY;
 			free( bmp );
-			return NULL;
+			return BMP_OUT_OF_MEMORY;
 		}
 	}
 	else
@@ -157,16 +196,15 @@ BMP* BMP_Create( UINT width, UINT height, USHORT depth )
 	bmp->Data = (UCHAR*) calloc( bmp->Header.ImageDataSize, sizeof( UCHAR ) );
 	if ( bmp->Data == NULL )
 	{
-		BMP_LAST_ERROR_CODE = BMP_OUT_OF_MEMORY;
 		free( bmp->Palette );
 		free( bmp );
-		return NULL;
+		return BMP_OUT_OF_MEMORY;
 	}
 
 
-	BMP_LAST_ERROR_CODE = BMP_OK;
+	*out = bmp;
 
-	return bmp;
+	return BMP_OK;
 }
 
 
@@ -180,14 +218,22 @@ void BMP_Free( BMP* bmp )
 		return;
 	}
 
-	if ( bmp->Palette != NULL )
+	if ( bmp->MapBase != NULL )
 	{
-		free( bmp->Palette );
+		/* Palette and data point into the mapping */
+		munmap( bmp->MapBase, bmp->MapLength );
 	}
-
-	if ( bmp->Data != NULL )
+	else
 	{
-		free( bmp->Data );
+		if ( bmp->Palette != NULL )
+		{
+			free( bmp->Palette );
+		}
+
+		if ( bmp->Data != NULL )
+		{
+			free( bmp->Data );
+		}
 	}
 
 	free( bmp );
@@ -200,14 +246,35 @@ void BMP_Free( BMP* bmp )
 	Reads the specified BMP image file.
 **************************************************************/
 BMP* BMP_ReadFile( const char* filename )
+{
+	BMP*	bmp;
+
+	BMP_LAST_ERROR_CODE = BMP_ReadFileEx( filename, &bmp );
+
+	return bmp;
+}
+
+
+/**************************************************************
+	Reads the specified BMP image file into *out. Returns the
+	operation's status instead of recording it as the last
+	error code.
+**************************************************************/
+BMP_STATUS BMP_ReadFileEx( const char* filename, BMP** out )
 {
 	BMP*	bmp;
 	FILE*	f;
 
+	if ( out == NULL )
+	{
+		return BMP_INVALID_ARGUMENT;
+	}
+
+	*out = NULL;
+
 	if ( filename == NULL )
 	{
-		BMP_LAST_ERROR_CODE = BMP_INVALID_ARGUMENT;
-		return NULL;
+		return BMP_INVALID_ARGUMENT;
 	}
 
 
@@ -215,8 +282,7 @@ BMP* BMP_ReadFile( const char* filename )
 	bmp = calloc( 1, sizeof( BMP ) );
 	if ( bmp == NULL )
 	{
-		BMP_LAST_ERROR_CODE = BMP_OUT_OF_MEMORY;
-		return NULL;
+		return BMP_OUT_OF_MEMORY;
 	}
 
 
@@ -224,19 +290,17 @@ BMP* BMP_ReadFile( const char* filename )
 	f = fopen( filename, "rb" );
 	if ( f == NULL )
 	{
-		BMP_LAST_ERROR_CODE = BMP_FILE_NOT_FOUND;
 		free( bmp );
-		return NULL;
+		return BMP_FILE_NOT_FOUND;
 	}
 
 
 	/* Read header */
 	if ( ReadHeader( bmp, f ) != BMP_OK || bmp->Header.Magic != 0x4D42 )
 	{
-		BMP_LAST_ERROR_CODE = BMP_FILE_INVALID;
 		fclose( f );
 		free( bmp );
-		return NULL;
+		return BMP_FILE_INVALID;
 	}
 
 
@@ -244,10 +308,18 @@ BMP* BMP_ReadFile( const char* filename )
 	if ( ( bmp->Header.BitsPerPixel != 32 && bmp->Header.BitsPerPixel != 24 && bmp->Header.BitsPerPixel != 8 )
 		|| bmp->Header.CompressionType != 0 || bmp->Header.HeaderSize != 40 )
 	{
-		BMP_LAST_ERROR_CODE = BMP_FILE_NOT_SUPPORTED;
 		fclose( f );
 		free( bmp );
-		return NULL;
+		return BMP_FILE_NOT_SUPPORTED;
+	}
+
+
+	/* Verify that every row of pixels fits in the image data */
+	if ( !RowsFitData( bmp ) )
+	{
+		fclose( f );
+		free( bmp );
+		return BMP_FILE_INVALID;
 	}
 
 
@@ -257,19 +329,17 @@ BMP* BMP_ReadFile( const char* filename )
 		bmp->Palette = (UCHAR*) malloc( BMP_PALETTE_SIZE * sizeof( UCHAR ) );
 		if ( bmp->Palette == NULL )
 		{
-			BMP_LAST_ERROR_CODE = BMP_OUT_OF_MEMORY;
 			fclose( f );
 			free( bmp );
-			return NULL;
+			return BMP_OUT_OF_MEMORY;
 		}
 
 		if ( fread( bmp->Palette, sizeof( UCHAR ), BMP_PALETTE_SIZE, f ) != BMP_PALETTE_SIZE )
 		{
-			BMP_LAST_ERROR_CODE = BMP_FILE_INVALID;
 			fclose( f );
 			free( bmp->Palette );
 			free( bmp );
-			return NULL;
+			return BMP_FILE_INVALID;
 		}
 	}
 	else	/* Not an indexed image */
@@ -282,89 +352,225 @@ BMP* BMP_ReadFile( const char* filename )
 	bmp->Data = (UCHAR*) malloc( bmp->Header.ImageDataSize );
 	if ( bmp->Data == NULL )
 	{
-		BMP_LAST_ERROR_CODE = BMP_OUT_OF_MEMORY;
 		fclose( f );
 		free( bmp->Palette );
 		free( bmp );
-		return NULL;
+		return BMP_OUT_OF_MEMORY;
 	}
 
 
 	/* Read image data */
 	if ( fread( bmp->Data, sizeof( UCHAR ), bmp->Header.ImageDataSize, f ) != bmp->Header.ImageDataSize )
 	{
-		BMP_LAST_ERROR_CODE = BMP_FILE_INVALID;
 		fclose( f );
 		free( bmp->Data );
 		free( bmp->Palette );
 		free( bmp );
-		return NULL;
+		return BMP_FILE_INVALID;
 	}
 
 
 	fclose( f );
 
-	BMP_LAST_ERROR_CODE = BMP_OK;
+	*out = bmp;
+
+	return BMP_OK;
+}
+
+
+/**************************************************************
+	Maps the specified BMP image file into memory instead of
+	reading it. The image's pixels point directly into the
+	mapping, so nothing is copied up front and only the pages
+	that are accessed are ever read from disk.
+
+	The mapping is private: writing to the image's pixels
+	copies the affected pages and never modifies the file.
+**************************************************************/
+BMP* BMP_MapFile( const char* filename )
+{
+	BMP*	bmp;
+
+	BMP_LAST_ERROR_CODE = BMP_MapFileEx( filename, &bmp );
 
 	return bmp;
 }
 
 
 /**************************************************************
-	Writes the BMP image to the specified file.
+	Maps the specified BMP image file into *out. Returns the
+	operation's status instead of recording it as the last
+	error code.
 **************************************************************/
-void BMP_WriteFile( BMP* bmp, const char* filename )
+BMP_STATUS BMP_MapFileEx( const char* filename, BMP** out )
 {
-	FILE*	f;
+	BMP*		bmp;
+	int			fd;
+	struct stat	info;
+	UCHAR*		map;
+	size_t		length;
+
+	if ( out == NULL )
+	{
+		return BMP_INVALID_ARGUMENT;
+	}
+
+	*out = NULL;
 
 	if ( filename == NULL )
 	{
-		BMP_LAST_ERROR_CODE = BMP_INVALID_ARGUMENT;
-		return;
+		return BMP_INVALID_ARGUMENT;
 	}
 
 
-	/* Open file */
-	f = fopen( filename, "wb" );
-	if ( f == NULL )
+	/* Open and map file */
+	fd = open( filename, O_RDONLY );
+	if ( fd < 0 )
 	{
-		BMP_LAST_ERROR_CODE = BMP_FILE_NOT_FOUND;
-		return;
+		return BMP_FILE_NOT_FOUND;
 	}
 
+	if ( fstat( fd, &info ) != 0 )
+	{
+		close( fd );
+		return BMP_IO_ERROR;
+	}
 
-	/* Write header */
-	if ( WriteHeader( bmp, f ) != BMP_OK )
+	length = (size_t) info.st_size;
+	if ( length < BMP_HEADER_SIZE )
 	{
-		BMP_LAST_ERROR_CODE = BMP_IO_ERROR;
-		fclose( f );
-		return;
+		close( fd );
+		return BMP_FILE_INVALID;
+	}
+
+	map = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( map == MAP_FAILED )
+	{
+		return BMP_IO_ERROR;
+	}
+
+
+	/* Allocate */
+	bmp = calloc( 1, sizeof( BMP ) );
+	if ( bmp == NULL )
+	{
+		munmap( map, length );
+		return BMP_OUT_OF_MEMORY;
+	}
+
+	bmp->MapBase = map;
+	bmp->MapLength = length;
+
+
+	/* Parse header */
+	DecodeHeader( bmp, map );
+	if ( bmp->Header.Magic != 0x4D42 )
+	{
+		munmap( map, length );
+		free( bmp );
+		return BMP_FILE_INVALID;
+	}
+
+
+	/* Verify that the bitmap variant is supported */
+	if ( ( bmp->Header.BitsPerPixel != 32 && bmp->Header.BitsPerPixel != 24 && bmp->Header.BitsPerPixel != 8 )
+		|| bmp->Header.CompressionType != 0 || bmp->Header.HeaderSize != 40 )
+	{
+		munmap( map, length );
+		free( bmp );
+		return BMP_FILE_NOT_SUPPORTED;
+	}
+
+
+	/* Verify that the palette and pixels are inside the file */
+	if ( ( bmp->Header.BitsPerPixel == 8 && length < BMP_HEADER_SIZE + BMP_PALETTE_SIZE )
+		|| !RowsFitData( bmp ) || bmp->Header.DataOffset > length
+		|| bmp->Header.ImageDataSize > length - bmp->Header.DataOffset )
+	{
+		munmap( map, length );
+		free( bmp );
+		return BMP_FILE_INVALID;
 	}
 
 
-	/* Write palette */
+	/* Point palette and pixels into the mapping */
+	bmp->Palette = bmp->Header.BitsPerPixel == 8 ? map + BMP_HEADER_SIZE : NULL;
+	bmp->Data = map + bmp->Header.DataOffset;
+
+	*out = bmp;
+
+	return BMP_OK;
+}
+
+
+/**************************************************************
+	Writes the BMP image to the specified file.
+**************************************************************/
+void BMP_WriteFile( BMP* bmp, const char* filename )
+{
+	BMP_LAST_ERROR_CODE = BMP_WriteFileEx( bmp, filename );
+}
+
+
+/**************************************************************
+	Writes the BMP image to the specified file. Returns the
+	operation's status instead of recording it as the last
+	error code.
+**************************************************************/
+BMP_STATUS BMP_WriteFileEx( BMP* bmp, const char* filename )
+{
+	int				fd;
+	UCHAR			header[ BMP_HEADER_SIZE ];
+	struct iovec	iov[ 3 ];
+	int				count = 0;
+
+	if ( bmp == NULL || filename == NULL )
+	{
+		return BMP_INVALID_ARGUMENT;
+	}
+
+
+	/* Open file */
+	fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+	if ( fd < 0 )
+	{
+		return BMP_FILE_NOT_FOUND;
+	}
+
+
+	/* Gather header, palette and data so that they are written by as few
+	system calls as possible, usually one */
+	EncodeHeader( bmp, header );
+	iov[ count ].iov_base = header;
+	iov[ count ].iov_len = BMP_HEADER_SIZE;
+	++count;
+
 	if ( bmp->Palette )
 	{
-		if ( fwrite( bmp->Palette, sizeof( UCHAR ), BMP_PALETTE_SIZE, f ) != BMP_PALETTE_SIZE )
-		{
-			BMP_LAST_ERROR_CODE = BMP_IO_ERROR;
-			fclose( f );
-			return;
-		}
+		iov[ count ].iov_base = bmp->Palette;
+		iov[ count ].iov_len = BMP_PALETTE_SIZE;
+		++count;
 	}
 
+	iov[ count ].iov_base = bmp->Data;
+	iov[ count ].iov_len = bmp->Header.ImageDataSize;
+	++count;
 
-	/* Write data */
-	if ( fwrite( bmp->Data, sizeof( UCHAR ), bmp->Header.ImageDataSize, f ) != bmp->Header.ImageDataSize )
+
+	/* Write everything */
+	if ( !WriteAll( fd, iov, count ) )
 	{
-		BMP_LAST_ERROR_CODE = BMP_IO_ERROR;
-		fclose( f );
-		return;
+		close( fd );
+		return BMP_IO_ERROR;
 	}
 
+	if ( close( fd ) != 0 )
+	{
+		return BMP_IO_ERROR;
+	}
 
-	BMP_LAST_ERROR_CODE = BMP_OK;
-	fclose( f );
+	return BMP_OK;
 }
 
 
@@ -419,6 +625,30 @@ USHORT BMP_GetDepth( BMP* bmp )
 }
 
 
+/**************************************************************
+	Resets the header fields that do not describe the pixels
+	(resolution, color counts, reserved fields and the offsets
+	of the file) to the values BMP_Create gives them, so that the
+	image is written as a new image of the same size would be.
+**************************************************************/
+void BMP_ResetHeader( BMP* bmp )
+{
+	if ( bmp == NULL )
+	{
+		return;
+	}
+
+	bmp->Header.Reserved1			= 0;
+	bmp->Header.Reserved2			= 0;
+	bmp->Header.HPixelsPerMeter		= 0;
+	bmp->Header.VPixelsPerMeter		= 0;
+	bmp->Header.ColorsUsed			= 0;
+	bmp->Header.ColorsRequired		= 0;
+	bmp->Header.DataOffset			= 54 + ( bmp->Header.BitsPerPixel == 8 ? BMP_PALETTE_SIZE : 0 );
+	bmp->Header.FileSize			= bmp->Header.ImageDataSize + bmp->Header.DataOffset;
+}
+
+
 /**************************************************************
 	Populates the arguments with the specified pixel's RGB
 	values.
@@ -566,6 +796,39 @@ void BMP_SetPixelIndex( BMP* bmp, UINT x, UINT y, UCHAR val )
 }
 
 
+/**************************************************************
+	Returns a pointer to the first byte of the specified row's
+	pixel data. Rows are stored bottom-up, so consecutive rows
+	are BMP_GetBytesPerRow() bytes apart in decreasing address
+	order. Returns NULL if the row is out of range.
+**************************************************************/
+UCHAR* BMP_GetRowPointer( BMP* bmp, UINT y )
+{
+	if ( bmp == NULL || y >= bmp->Header.Height )
+	{
+		return NULL;
+	}
+
+	return bmp->Data + ( bmp->Header.Height - y - 1 ) * BMP_GetBytesPerRow( bmp );
+}
+
+
+/**************************************************************
+	Returns the number of bytes used to store a single image
+	row, including the padding to the next multiple of 4.
+**************************************************************/
+UINT BMP_GetBytesPerRow( BMP* bmp )
+{
+	if ( bmp == NULL )
+	{
+		return 0;
+	}
+
+	/* Row's size is rounded up to the next multiple of 4 bytes */
+	return bmp->Header.ImageDataSize / bmp->Header.Height;
+}
+
+
 /**************************************************************
 	Gets the color value for the specified palette index.
 **************************************************************/
@@ -632,9 +895,18 @@ BMP_STATUS BMP_GetError()
 **************************************************************/
 const char* BMP_GetErrorDescription()
 {
-	if ( BMP_LAST_ERROR_CODE > 0 && BMP_LAST_ERROR_CODE < BMP_ERROR_NUM )
+	return BMP_GetStatusDescription( BMP_LAST_ERROR_CODE );
+}
+
+
+/**************************************************************
+	Returns a description of the specified status code.
+**************************************************************/
+const char* BMP_GetStatusDescription( BMP_STATUS status )
+{
+	if ( status > 0 && status < BMP_ERROR_NUM )
 	{
-		return BMP_ERROR_STRING[ BMP_LAST_ERROR_CODE ];
+		return BMP_ERROR_STRING[ status ];
 	}
 	else
 	{
@@ -655,144 +927,173 @@ const char* BMP_GetErrorDescription()
 **************************************************************/
 int	ReadHeader( BMP* bmp, FILE* f )
 {
+	UCHAR header[ BMP_HEADER_SIZE ];
+
 	if ( bmp == NULL || f == NULL )
 	{
 		return BMP_INVALID_ARGUMENT;
 	}
 
-	/* The header's fields are read one by one, and converted from the format's
-	little endian to the system's native representation. */
-	if ( !ReadUSHORT( &( bmp->Header.Magic ), f ) )			return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.FileSize ), f ) )		return BMP_IO_ERROR;
-	if ( !ReadUSHORT( &( bmp->Header.Reserved1 ), f ) )		return BMP_IO_ERROR;
-	if ( !ReadUSHORT( &( bmp->Header.Reserved2 ), f ) )		return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.DataOffset ), f ) )		return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.HeaderSize ), f ) )		return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.Width ), f ) )			return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.Height ), f ) )			return BMP_IO_ERROR;
-	if ( !ReadUSHORT( &( bmp->Header.Planes ), f ) )		return BMP_IO_ERROR;
-	if ( !ReadUSHORT( &( bmp->Header.BitsPerPixel ), f ) )	return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.CompressionType ), f ) )	return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.ImageDataSize ), f ) )	return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.HPixelsPerMeter ), f ) )	return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.VPixelsPerMeter ), f ) )	return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.ColorsUsed ), f ) )		return BMP_IO_ERROR;
-	if ( !ReadUINT( &( bmp->Header.ColorsRequired ), f ) )	return BMP_IO_ERROR;
+	/* The whole header is read at once and then decoded field by field */
+	if ( fread( header, BMP_HEADER_SIZE, 1, f ) != 1 )
+	{
+		return BMP_IO_ERROR;
+	}
+
+	DecodeHeader( bmp, header );
 
 	return BMP_OK;
 }
 
 
 /**************************************************************
-	Writes the BMP file's header into the data structure.
-	Returns BMP_OK on success.
+	Checks that the image data holds Height rows, each of them
+	long enough for Width pixels, since rows are found
+	ImageDataSize / Height bytes apart. Returns non-zero if so.
 **************************************************************/
-int	WriteHeader( BMP* bmp, FILE* f )
+int RowsFitData( BMP* bmp )
 {
-	if ( bmp == NULL || f == NULL )
+	UINT bytes_per_row;
+
+	if ( bmp->Header.Height == 0 )
 	{
-		return BMP_INVALID_ARGUMENT;
+		return 0;
 	}
 
-	/* The header's fields are written one by one, and converted to the format's
-	little endian representation. */
-	if ( !WriteUSHORT( bmp->Header.Magic, f ) )			return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.FileSize, f ) )		return BMP_IO_ERROR;
-	if ( !WriteUSHORT( bmp->Header.Reserved1, f ) )		return BMP_IO_ERROR;
-	if ( !WriteUSHORT( bmp->Header.Reserved2, f ) )		return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.DataOffset, f ) )		return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.HeaderSize, f ) )		return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.Width, f ) )			return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.Height, f ) )			return BMP_IO_ERROR;
-	if ( !WriteUSHORT( bmp->Header.Planes, f ) )		return BMP_IO_ERROR;
-	if ( !WriteUSHORT( bmp->Header.BitsPerPixel, f ) )	return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.CompressionType, f ) )	return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.ImageDataSize, f ) )	return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.HPixelsPerMeter, f ) )	return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.VPixelsPerMeter, f ) )	return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.ColorsUsed, f ) )		return BMP_IO_ERROR;
-	if ( !WriteUINT( bmp->Header.ColorsRequired, f ) )	return BMP_IO_ERROR;
-
-	return BMP_OK;
+	/* Divide instead of multiplying the width, which could overflow */
+	bytes_per_row = bmp->Header.ImageDataSize / bmp->Header.Height;
+	return bmp->Header.Width <= bytes_per_row / ( bmp->Header.BitsPerPixel >> 3 );
 }
 
 
 /**************************************************************
-	Reads a little-endian unsigned int from the file.
-	Returns non-zero on success.
+	Writes all the buffers to the file, retrying after partial
+	writes and interruptions. Returns non-zero on success.
 **************************************************************/
-int	ReadUINT( UINT* x, FILE* f )
+int WriteAll( int fd, struct iovec* iov, int count )
 {
-	UCHAR little[ 4 ];	/* BMPs use 32 bit ints */
+	ssize_t	written;
 
-	if ( x == NULL || f == NULL )
+	while ( count > 0 )
 	{
-		return 0;
-	}
+		written = writev( fd, iov, count );
+		if ( written < 0 )
+		{
+			if ( errno == EINTR )
+			{
+				continue;
+			}
+			return 0;
+		}
 
-	if ( fread( little, 4, 1, f ) != 1 )
-	{
-		return 0;
-	}
+		/* Skip the buffers that were written completely */
+		while ( count > 0 && (size_t) written >= iov->iov_len )
+		{
+			written -= iov->iov_len;
+			++iov;
+			--count;
+		}
 
-	*x = ( little[ 3 ] << 24 | little[ 2 ] << 16 | little[ 1 ] << 8 | little[ 0 ] );
+		/* Advance into the buffer that was written partially */
+		if ( count > 0 )
+		{
+			iov->iov_base = (UCHAR*) iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
 
 	return 1;
 }
 
 
 /**************************************************************
-	Reads a little-endian unsigned short int from the file.
-	Returns non-zero on success.
+	Decodes the BMP file's header from the first
+	BMP_HEADER_SIZE bytes of the file.
 **************************************************************/
-int	ReadUSHORT( USHORT *x, FILE* f )
+void DecodeHeader( BMP* bmp, const UCHAR* buffer )
 {
-	UCHAR little[ 2 ];	/* BMPs use 16 bit shorts */
-
-	if ( x == NULL || f == NULL )
-	{
-		return 0;
-	}
-
-	if ( fread( little, 2, 1, f ) != 1 )
-	{
-		return 0;
-	}
+	/* The fields are little endian and packed without padding */
+	bmp->Header.Magic			= DecodeUSHORT( buffer + 0 );
+	bmp->Header.FileSize		= DecodeUINT( buffer + 2 );
+	bmp->Header.Reserved1		= DecodeUSHORT( buffer + 6 );
+	bmp->Header.Reserved2		= DecodeUSHORT( buffer + 8 );
+	bmp->Header.DataOffset		= DecodeUINT( buffer + 10 );
+	bmp->Header.HeaderSize		= DecodeUINT( buffer + 14 );
+	bmp->Header.Width			= DecodeUINT( buffer + 18 );
+	bmp->Header.Height			= DecodeUINT( buffer + 22 );
+	bmp->Header.Planes			= DecodeUSHORT( buffer + 26 );
+	bmp->Header.BitsPerPixel	= DecodeUSHORT( buffer + 28 );
+	bmp->Header.CompressionType	= DecodeUINT( buffer + 30 );
+	bmp->Header.ImageDataSize	= DecodeUINT( buffer + 34 );
+	bmp->Header.HPixelsPerMeter	= DecodeUINT( buffer + 38 );
+	bmp->Header.VPixelsPerMeter	= DecodeUINT( buffer + 42 );
+	bmp->Header.ColorsUsed		= DecodeUINT( buffer + 46 );
+	bmp->Header.ColorsRequired	= DecodeUINT( buffer + 50 );
+}
 
-	*x = ( little[ 1 ] << 8 | little[ 0 ] );
 
-	return 1;
+/**************************************************************
+	Encodes the BMP file's header into the first
+	BMP_HEADER_SIZE bytes of the buffer.
+**************************************************************/
+void EncodeHeader( BMP* bmp, UCHAR* buffer )
+{
+	/* The fields are little endian and packed without padding */
+	EncodeUSHORT( bmp->Header.Magic, buffer + 0 );
+	EncodeUINT( bmp->Header.FileSize, buffer + 2 );
+	EncodeUSHORT( bmp->Header.Reserved1, buffer + 6 );
+	EncodeUSHORT( bmp->Header.Reserved2, buffer + 8 );
+	EncodeUINT( bmp->Header.DataOffset, buffer + 10 );
+	EncodeUINT( bmp->Header.HeaderSize, buffer + 14 );
+	EncodeUINT( bmp->Header.Width, buffer + 18 );
+	EncodeUINT( bmp->Header.Height, buffer + 22 );
+	EncodeUSHORT( bmp->Header.Planes, buffer + 26 );
+	EncodeUSHORT( bmp->Header.BitsPerPixel, buffer + 28 );
+	EncodeUINT( bmp->Header.CompressionType, buffer + 30 );
+	EncodeUINT( bmp->Header.ImageDataSize, buffer + 34 );
+	EncodeUINT( bmp->Header.HPixelsPerMeter, buffer + 38 );
+	EncodeUINT( bmp->Header.VPixelsPerMeter, buffer + 42 );
+	EncodeUINT( bmp->Header.ColorsUsed, buffer + 46 );
+	EncodeUINT( bmp->Header.ColorsRequired, buffer + 50 );
 }
 
 
 /**************************************************************
-	Writes a little-endian unsigned int to the file.
-	Returns non-zero on success.
+	Decodes a little-endian unsigned int from the buffer.
 **************************************************************/
-int	WriteUINT( UINT x, FILE* f )
+UINT DecodeUINT( const UCHAR* buffer )
 {
-	UCHAR little[ 4 ];	/* BMPs use 32 bit ints */
+	return ( (UINT) buffer[ 3 ] << 24 | (UINT) buffer[ 2 ] << 16 | (UINT) buffer[ 1 ] << 8 | buffer[ 0 ] );
+}
 
-	little[ 3 ] = (UCHAR)( ( x & 0xff000000 ) >> 24 );
-	little[ 2 ] = (UCHAR)( ( x & 0x00ff0000 ) >> 16 );
-	little[ 1 ] = (UCHAR)( ( x & 0x0000ff00 ) >> 8 );
-	little[ 0 ] = (UCHAR)( ( x & 0x000000ff ) >> 0 );
 
-	return ( f && fwrite( little, 4, 1, f ) == 1 );
+/**************************************************************
+	Decodes a little-endian unsigned short int from the buffer.
+**************************************************************/
+USHORT DecodeUSHORT( const UCHAR* buffer )
+{
+	return (USHORT)( buffer[ 1 ] << 8 | buffer[ 0 ] );
 }
 
 
 /**************************************************************
-	Writes a little-endian unsigned short int to the file.
-	Returns non-zero on success.
+	Encodes an unsigned int into the buffer as little-endian.
 **************************************************************/
-int	WriteUSHORT( USHORT x, FILE* f )
+void EncodeUINT( UINT x, UCHAR* buffer )
 {
-	UCHAR little[ 2 ];	/* BMPs use 16 bit shorts */
+	buffer[ 3 ] = (UCHAR)( ( x & 0xff000000 ) >> 24 );
+	buffer[ 2 ] = (UCHAR)( ( x & 0x00ff0000 ) >> 16 );
+	buffer[ 1 ] = (UCHAR)( ( x & 0x0000ff00 ) >> 8 );
+	buffer[ 0 ] = (UCHAR)( ( x & 0x000000ff ) >> 0 );
+}
 
-	little[ 1 ] = (UCHAR)( ( x & 0xff00 ) >> 8 );
-	little[ 0 ] = (UCHAR)( ( x & 0x00ff ) >> 0 );
 
-	return ( f && fwrite( little, 2, 1, f ) == 1 );
+/**************************************************************
+	Encodes an unsigned short int into the buffer as
+	little-endian.
+**************************************************************/
+void EncodeUSHORT( USHORT x, UCHAR* buffer )
+{
+	buffer[ 1 ] = (UCHAR)( ( x & 0xff00 ) >> 8 );
+	buffer[ 0 ] = (UCHAR)( ( x & 0x00ff ) >> 0 );
 }
-
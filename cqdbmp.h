@@ -96,13 +96,24 @@ void			BMP_Free					( BMP* bmp );
 
 /* I/O */
 BMP*			BMP_ReadFile				( const char* filename );
+BMP*			BMP_MapFile					( const char* filename );
 void			BMP_WriteFile				( BMP* bmp, const char* filename );
 
 
+/* Status-returning variants of the above. They report their outcome only
+   through the return value and leave the last error code untouched, so
+   they are safe to call from several threads at once. */
+BMP_STATUS		BMP_CreateEx				( UINT width, UINT height, USHORT depth, BMP** bmp );
+BMP_STATUS		BMP_ReadFileEx				( const char* filename, BMP** bmp );
+BMP_STATUS		BMP_MapFileEx				( const char* filename, BMP** bmp );
+BMP_STATUS		BMP_WriteFileEx				( BMP* bmp, const char* filename );
+
+
 /* Meta info */
 UINT			BMP_GetWidth				( BMP* bmp );
 UINT			BMP_GetHeight				( BMP* bmp );
 USHORT			BMP_GetDepth				( BMP* bmp );
+void			BMP_ResetHeader				( BMP* bmp );
 
 
 /* Pixel access */
@@ -112,14 +123,20 @@ void			BMP_GetPixelIndex			( BMP* bmp, UINT x, UINT y, UCHAR* val );
 void			BMP_SetPixelIndex			( BMP* bmp, UINT x, UINT y, UCHAR val );
 
 
+/* Raw pixel access */
+UCHAR*			BMP_GetRowPointer			( BMP* bmp, UINT y );
+UINT			BMP_GetBytesPerRow			( BMP* bmp );
+
+
 /* Palette handling */
 void			BMP_GetPaletteColor			( BMP* bmp, UCHAR index, UCHAR* r, UCHAR* g, UCHAR* b );
 void			BMP_SetPaletteColor			( BMP* bmp, UCHAR index, UCHAR r, UCHAR g, UCHAR b );
 
 
-/* Error handling */
+/* Error handling. The last error code is kept per thread. */
 BMP_STATUS		BMP_GetError				();
 const char*		BMP_GetErrorDescription		();
+const char*		BMP_GetStatusDescription	( BMP_STATUS status );
 
 
 /* Useful macro that may be used after each BMP operation to check for an error */
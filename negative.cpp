@@ -1,29 +1,52 @@
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <optional>
 #include <string>
+#include "PixelKernels.hpp"
+#include "ThreadPool.hpp"
 #include "qdbmp.hpp"
 
 using std::cerr;
 using std::endl;
 using std::string;
 
-constexpr UCHAR MAX_COLOR_VALUE = 255U;
-
 /**
  * This program takes a .bmp image and generates its corresponding "negative"
  * image to a new .bmp file on disk.
  */
 int main(int argc, char* argv[]) {
   // Check input commands
-  if (argc != 3) {
-    cerr << "Usage: " << argv[0] << " <input file> <output file>" << endl;
+  if (argc != 3 && argc != 4) {
+    cerr << "Usage: " << argv[0] << " <input file> <output file>"
+         << " [--threads=N]" << endl;
     return EXIT_FAILURE;
   }
 
   string input_fname{argv[1]};
   string output_fname{argv[2]};
 
-  // Construct a BitMap object using the input file specified
+  // Check the optional thread count, 0 uses every hardware thread
+  unsigned thread_count = 0;
+  if (argc == 4) {
+    string flag{argv[3]};
+    size_t pos = 0;
+    try {
+      if (flag.rfind("--threads=", 0) == 0) {
+        thread_count = std::stoul(flag.substr(10), &pos);
+      }
+    } catch (const std::logic_error& e) {
+      pos = 0;
+    }
+    if (pos == 0 || pos != flag.length() - 10) {
+      cerr << "The thread count should be --threads=N." << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Construct a BitMap object using the input file specified. The image is
+  // read rather than mapped: every pixel gets overwritten, and a mapped
+  // image would have to copy each page on its first write.
   BitMap image(input_fname);
 
   // Check the command above succeed
@@ -32,40 +55,47 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  // Create a new BitMap for output the negative image
   const unsigned int height = image.height();
   const unsigned int width = image.width();
-  BitMap negative(width, height);
+  ThreadPool pool(thread_count);
 
-  // Check the command above succeed
-  if (negative.check_error() != BMP_OK) {
-    perror("ERROR: Failed to open BMP file.");
-    return EXIT_FAILURE;
-  }
-
-  // Loop through each pixel and turn into negative
-  for (size_t y = 0; y < height; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      // Read the current pixel RGB color
-      RGB color = image.get_pixel(x, y);
+  // Output images are always 32 BPP. Those are inverted in place, so only
+  // images of another depth need a second BitMap to convert into.
+  std::optional<BitMap> converted;
+  if (image.bytes_per_pixel() != 4) {
+    converted.emplace(width, height);
 
-      // Calculate the negative RGB color
-      RGB reverse_color{
-          static_cast<UCHAR>(MAX_COLOR_VALUE - color.red),
-          static_cast<UCHAR>(MAX_COLOR_VALUE - color.green),
-          static_cast<UCHAR>(MAX_COLOR_VALUE - color.blue),
-      };
-
-      // Set the negative color
-      negative.set_pixel(x, y, reverse_color);
+    // Check the command above succeed
+    if (converted->check_error() != BMP_OK) {
+      perror("ERROR: Failed to open BMP file.");
+      return EXIT_FAILURE;
     }
   }
+  BitMap& negative = converted ? *converted : image;
+  // An image inverted in place is written with its own header otherwise,
+  // resolution and all, instead of the one of a new BitMap
+  negative.reset_header();
+
+  // Turn every pixel into its negative, with rows split between the
+  // workers of the pool
+  pool.parallel_for(0, height, 0, [&](size_t startY, size_t endY) {
+    for (size_t y = startY; y < endY; ++y) {
+      RowSpan out = negative.row(y);
+      if (converted) {
+        RowSpan in = image.row(y);
+        for (size_t x = 0; x < width; ++x) {
+          std::copy_n(in.pixel(x), in.bytes_per_pixel, out.pixel(x));
+        }
+      }
+      invert_row(out);
+    }
+  });
 
   // Output the negative image to disk
   negative.write_file(output_fname);
 
-  if (image.check_error() != BMP_OK) {
-    perror("ERROR: Failed to open BMP file.");
+  if (negative.check_error() != BMP_OK) {
+    perror("ERROR: Failed to write BMP file.");
     return EXIT_FAILURE;
   }
 
@@ -1,33 +1,37 @@
 #include <pthread.h>
-#include <unistd.h>   // For sleep
-#include <algorithm>  // For max_element and min_element
-#include <iomanip>
+#include <unistd.h>   // For read
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>  // For to_chars
+#include <cstring>
 #include <iostream>
-#include <numeric>
 #include <optional>
-#include <sstream>  // For std::stringstream
+#include <span>
+#include <string>
 #include <vector>
-#include "DoubleQueue.hpp"  // Ensure this is implemented correctly.
+#include "NumberParsing.hpp"
+#include "SlidingWindowStats.hpp"
+#include "SpscQueue.hpp"
 
 using namespace std;
 
-DoubleQueue queue;
-volatile bool endOfInput = false;  // Flag to indicate the end of input (EOF)
+// The reader is the only thread that adds and the printer the only one that
+// removes, so the lock-free single producer, single consumer queue is
+// enough. It is bounded, so that a reader far ahead of the printer waits
+// for it instead of growing the queue without limit.
+constexpr size_t kQueueCapacity = 4096;
+SpscQueue<double> queue(kQueueCapacity);
 
-pthread_mutex_t cinMutex = PTHREAD_MUTEX_INITIALIZER;   // Mutex for cin
-pthread_mutex_t coutMutex = PTHREAD_MUTEX_INITIALIZER;  // Mutex for cout
+// Standard input is read this many bytes at a time, and the numbers parsed
+// from it are added to the queue this many at a time
+constexpr size_t kReadBlock = 1 << 20;
+constexpr size_t kAddBatch = 256;
 
-// Function to perform synchronized input operation
-bool synchronizedInput(string& input) {
-  pthread_mutex_lock(&cinMutex);
-  if (!getline(cin, input)) {
-    endOfInput = true;  // Signal EOF has been encountered
-    pthread_mutex_unlock(&cinMutex);
-    return false;
-  }
-  pthread_mutex_unlock(&cinMutex);
-  return true;
-}
+// The statistics are over this many most recent numbers
+constexpr size_t kWindow = 5;
+
+pthread_mutex_t coutMutex = PTHREAD_MUTEX_INITIALIZER;  // Mutex for cout
 
 // Function to perform synchronized output operation
 void synchronizedOutput(const string& output) {
@@ -36,61 +40,101 @@ void synchronizedOutput(const string& output) {
   pthread_mutex_unlock(&coutMutex);  // Unlock cout mutex
 }
 
+// Reads standard input in large blocks, parses every line that starts with
+// a number, and adds the numbers to the queue in batches. Lines that do not
+// start with a number are ignored. Each batch is added once its block is
+// parsed, so numbers typed at a terminal are not held back.
 void* readerThread(void* arg) {
-  double num;
+  vector<char> buffer(kReadBlock);
+  size_t kept = 0;  // bytes of an unfinished line at the front of buffer
+  array<double, kAddBatch> batch;
+  size_t count = 0;
+  auto flush = [&count, &batch] {
+    queue.add_bulk(span<const double>(batch.data(), count));
+    count = 0;
+  };
+  auto parse = [&](const char* first, const char* last) {
+    if (optional<double> num = parseLine(first, last)) {
+      batch[count++] = num.value();
+      if (count == batch.size()) {
+        flush();
+      }
+    }
+  };
+
   while (true) {
-    string input;
-    if (!synchronizedInput(
-            input))  // Perform synchronized input and check for EOF
-      break;         // Exit loop if end of input
-
-    if (input.empty())
-      continue;  // Skip empty input lines
-
-    // convert string input to double, and add it to queue
-    try {
-      num = stod(input);
-      queue.add(num);
-      sleep(1);  // Sleep for 1 second after adding a number
-    } catch (const invalid_argument& e) {
-      // Ignore non-numeric inputs
-    } catch (const out_of_range& e) {
-      // Ignore inputs that are out of double range
+    if (kept == buffer.size()) {
+      buffer.resize(buffer.size() * 2);  // A line longer than a block
+    }
+    ssize_t got = read(STDIN_FILENO, buffer.data() + kept, buffer.size() - kept);
+    if (got < 0 && errno == EINTR) {
+      continue;
     }
+    const char* line = buffer.data();
+    const char* end = buffer.data() + kept + max<ssize_t>(got, 0);
+    // Only the new bytes can hold the end of the unfinished line
+    const char* scan = buffer.data() + kept;
+    while (const char* newline =
+               static_cast<const char*>(memchr(scan, '\n', end - scan))) {
+      parse(line, newline);
+      line = newline + 1;
+      scan = line;
+    }
+    if (got <= 0) {
+      // End of input (or an error reading it): the last line may have no
+      // newline
+      if (line != end) {
+        parse(line, end);
+      }
+      break;
+    }
+    kept = end - line;
+    memmove(buffer.data(), line, kept);
+    flush();
   }
+  flush();
   queue.close();  // Signal to the printerThread that there will be no more
                   // numbers
   return nullptr;
 }
 
-void* printerThread(void* arg) {
-  vector<double> lastFiveNumbers;
-  optional<double> num;
-  while ((num = queue.wait_remove())) {
-    lastFiveNumbers.push_back(*num);
-    if (lastFiveNumbers.size() > 5) {
-      lastFiveNumbers.erase(lastFiveNumbers.begin());
-    }
+// Appends val to out with two digits after the decimal point, exactly as
+// cout << fixed << setprecision(2) prints it
+void appendFixed(string& out, double val) {
+  // Enough for the integer digits of the largest double
+  char digits[400];
+  to_chars_result result =
+      to_chars(digits, digits + sizeof(digits), val, chars_format::fixed, 2);
+  out.append(digits, result.ptr);
+}
 
-    stringstream output;  // Use stringstream to construct output
-    output << setprecision(2) << fixed;
-    output << "Max: "
-           << *max_element(lastFiveNumbers.begin(), lastFiveNumbers.end())
-           << endl;
-    output << "Min: "
-           << *min_element(lastFiveNumbers.begin(), lastFiveNumbers.end())
-           << endl;
-    output << "Average: "
-           << accumulate(lastFiveNumbers.begin(), lastFiveNumbers.end(), 0.0) /
-                  lastFiveNumbers.size()
-           << endl;
-    output << "Last five: ";
-    for (double val : lastFiveNumbers) {
-      output << val << " ";
+void* printerThread(void* arg) {
+  SlidingWindowStats lastFiveNumbers(kWindow);
+  // Take every number that is ready in one go, so the reader is woken and
+  // the output is written once per batch instead of once per number
+  array<double, 64> batch;
+  size_t count;
+  string output;  // Reused, so its memory is only allocated once
+  while ((count = queue.wait_remove_bulk(batch, batch.size())) > 0) {
+    output.clear();
+    for (size_t i = 0; i < count; ++i) {
+      lastFiveNumbers.add(batch[i]);
+
+      output += "Max: ";
+      appendFixed(output, lastFiveNumbers.max());
+      output += "\nMin: ";
+      appendFixed(output, lastFiveNumbers.min());
+      output += "\nAverage: ";
+      appendFixed(output, lastFiveNumbers.mean());
+      output += "\nLast five: ";
+      for (size_t j = 0; j < lastFiveNumbers.size(); ++j) {
+        appendFixed(output, lastFiveNumbers.at(j));
+        output += ' ';
+      }
+      output += '\n';
     }
-    output << endl;
 
-    synchronizedOutput(output.str());  // Perform synchronized output
+    synchronizedOutput(output);  // Perform synchronized output
   }
   return nullptr;
 }
@@ -98,6 +142,9 @@ void* printerThread(void* arg) {
 int main() {
   pthread_t readerThreadId, printerThreadId;
 
+  // Only the printer writes to cout, in large blocks
+  ios::sync_with_stdio(false);
+
   // Create threads
   pthread_create(&readerThreadId, nullptr, readerThread, nullptr);
   pthread_create(&printerThreadId, nullptr, printerThread, nullptr);
@@ -107,7 +154,6 @@ int main() {
   pthread_join(printerThreadId, nullptr);
 
   // Destroy mutexes
-  pthread_mutex_destroy(&cinMutex);
   pthread_mutex_destroy(&coutMutex);
 
   return 0;
@@ -14,11 +14,38 @@ std::ostream& operator<<(std::ostream& out, RGB to_print) {
 
 // Implement BitMap class methods
 BitMap::BitMap(UINT width, UINT height) {
-  m_bmpPtr = BMP_Create(width, height, BMP_DEPTH);
+  m_status = BMP_CreateEx(width, height, BMP_DEPTH, &m_bmpPtr);
 }
 
-BitMap::BitMap(std::string file) {
-  m_bmpPtr = BMP_ReadFile(file.c_str());
+BitMap::BitMap(std::string file, LoadMode mode) {
+  if (mode == LoadMode::kMap) {
+    m_status = BMP_MapFileEx(file.c_str(), &m_bmpPtr);
+  } else {
+    m_status = BMP_ReadFileEx(file.c_str(), &m_bmpPtr);
+  }
+  if (m_status != BMP_OK || BMP_GetDepth(m_bmpPtr) != 8) {
+    return;
+  }
+
+  // Expand palette indices into BGRA pixels so that row() has one layout
+  // for every image. On failure the indexed image is kept and the error
+  // from BMP_CreateEx is left for check_error() to report.
+  UINT w = BMP_GetWidth(m_bmpPtr);
+  UINT h = BMP_GetHeight(m_bmpPtr);
+  BMP* expanded;
+  m_status = BMP_CreateEx(w, h, BMP_DEPTH, &expanded);
+  if (m_status != BMP_OK) {
+    return;
+  }
+  for (UINT y = 0; y < h; ++y) {
+    for (UINT x = 0; x < w; ++x) {
+      UCHAR r, g, b;
+      BMP_GetPixelRGB(m_bmpPtr, x, y, &r, &g, &b);
+      BMP_SetPixelRGB(expanded, x, y, r, g, b);
+    }
+  }
+  BMP_Free(m_bmpPtr);
+  m_bmpPtr = expanded;
 }
 
 BitMap::~BitMap() {
@@ -39,14 +66,30 @@ RGB BitMap::get_pixel(UINT x, UINT y) {
   return RGB(r, g, b);
 }
 
+UINT BitMap::bytes_per_pixel() {
+  return BMP_GetDepth(m_bmpPtr) >> 3;
+}
+
+RowSpan BitMap::row(UINT y) {
+  return RowSpan{BMP_GetRowPointer(m_bmpPtr, y), width(), bytes_per_pixel()};
+}
+
 void BitMap::set_pixel(UINT x, UINT y, RGB rgb) {
   BMP_SetPixelRGB(m_bmpPtr, x, y, rgb.red, rgb.green, rgb.blue);
 }
 
+void BitMap::reset_header() {
+  BMP_ResetHeader(m_bmpPtr);
+}
+
 void BitMap::write_file(std::string file) {
-  BMP_WriteFile(m_bmpPtr, file.c_str());
+  m_status = BMP_WriteFileEx(m_bmpPtr, file.c_str());
 }
 
 BMP_STATUS BitMap::check_error() {
-  return BMP_GetError();
+  return m_status;
+}
+
+const char* BitMap::error_description() {
+  return BMP_GetStatusDescription(m_status);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <iostream>
+#include <type_traits>
 
 // extern "C" needed to use something written in C
 extern "C" {
@@ -29,20 +30,68 @@ struct RGB {
 // cout << bleh;
 std::ostream& operator<<(std::ostream& out, RGB to_print);
 
+/**
+ * A view of the raw bytes of one image row, from left to right.
+ *
+ * Pixels are bytes_per_pixel bytes apart: 3 for BGR (24 BPP) images and
+ * 4 for BGRA (32 BPP) images. Within a pixel the blue, green and red
+ * channels are at offsets kBlue, kGreen and kRed.
+ */
+struct RowSpan {
+  static constexpr UINT kBlue = 0;
+  static constexpr UINT kGreen = 1;
+  static constexpr UINT kRed = 2;
+
+  UCHAR* data;
+  UINT width;
+  UINT bytes_per_pixel;
+
+  // Returns the first byte of pixel x
+  UCHAR* pixel(UINT x) const { return data + x * bytes_per_pixel; }
+
+  // Returns the number of pixel bytes in the row, excluding padding
+  UINT size_bytes() const { return width * bytes_per_pixel; }
+};
+
+// Calls fn with the pixel size (3 or 4) as a std::integral_constant so that
+// kernels can be instantiated per layout. Inner loops over raw bytes then
+// have a compile-time stride, which lets the compiler unroll and vectorize
+// them.
+template <typename Function>
+void dispatch_pixel_size(UINT bytes_per_pixel, Function fn) {
+  if (bytes_per_pixel == 4) {
+    fn(std::integral_constant<UINT, 4>{});
+  } else {
+    fn(std::integral_constant<UINT, 3>{});
+  }
+}
+
 /**
  * A class that represent a .bmp image. 
  * 
  * This class uses cqdbmp library to interact with the image, such as load/save a .bmp file,
  *   get/set a pixel in the .bmp file, and error checking. 
+ *
+ * Indexed (8 BPP) files are expanded to 32 BPP when loaded, so row() always
+ *   exposes BGR or BGRA pixels and never palette indices.
  * 
- * Note that all methods in this class may read/set error code in the cqdbmp library, 
- *   so you need to modify this class to support multi-threaded program.
+ * Each BitMap keeps the status of its own last load/create/write, using the
+ *   status-returning cqdbmp calls, so different threads can load, process and
+ *   write different BitMaps at the same time without sharing an error code.
  */
 class BitMap {
  public:
+  // How a BitMap constructed from a file gets its pixels
+  enum class LoadMode {
+    kRead,  // read the whole file into memory
+    kMap,   // map the file and use its pixels in place. Pages are read
+            // from disk only when touched and copied only when written;
+            // the file itself is never modified.
+  };
+
   // constructors
   BitMap(UINT width, UINT height);
-  BitMap(std::string file);
+  BitMap(std::string file, LoadMode mode = LoadMode::kRead);
   ~BitMap();
 
   // getters
@@ -50,14 +99,24 @@ class BitMap {
   UINT height();
   RGB get_pixel(UINT x, UINT y);
 
+  // raw pixel access, for tight loops that would otherwise call
+  // get_pixel/set_pixel per pixel. row(y) is only valid for y < height().
+  UINT bytes_per_pixel();
+  RowSpan row(UINT y);
+
   // setters
   void set_pixel(UINT x, UINT y, RGB rgb);
 
+  // resets the header fields that do not describe the pixels, such as the
+  // resolution, so the image is written as a new BitMap would be
+  void reset_header();
+
   // I/O
   void write_file(std::string file);
 
-  // error
+  // error: status of the last constructor or write_file call on this BitMap
   BMP_STATUS check_error();
+  const char* error_description();
 
   // The four lines below the comments make it so
   // that if you want to pass a BitMap as a parameter
@@ -75,6 +134,7 @@ class BitMap {
 
  private:
   BMP *m_bmpPtr;
+  BMP_STATUS m_status;
 };
 
 #endif  // QDBMP_H_
\ No newline at end of file
@@ -2,7 +2,7 @@
 #include <iomanip>
 #include <limits>
 #include <ios>
-#include <array>
+#include "SlidingWindowStats.hpp"
 
 using std::cout;
 using std::endl;
@@ -11,27 +11,20 @@ using std::cin;
 using std::setprecision;
 using std::numeric_limits;
 using std::streamsize;
-using std::array;
 
 // globals
 //
-// NOTE: When you modify this to use DobuleQueue to communciate between threads
-// one thread will need this array, and the threads should use DoubleQueue to communicate
-array<double, 6> nums;
-int len = 0;
-
-
-// reads the global array nums
-// and prints out statistics on it
-// if there are more than 5 elements in the
-// array, then the array is truncated down to
-// 5 elements
-// The array should never exceed 6 elements
+// the last five numbers read and their statistics
+SlidingWindowStats nums(5);
+
+
+// prints out the statistics on the
+// last five numbers in the global window nums
 void print_nums();
 
 
 // Reads a number from the console
-// and adds it to the global array called "nums".
+// and adds it to the global window called "nums".
 //
 // returns false when the EOF (ctrl + d)
 // is read. Meaning that the overall
@@ -48,30 +41,13 @@ int main() {
 }
 
 void print_nums() {
-  if (len <= 0) {
+  if (nums.size() == 0) {
     return;
   }
 
-  if (len > 5) {
-    for (int i = 0; i < 5; i++) {
-      nums.at(i) = nums.at(i+1);
-    }
-    len--;
-  }
-
-  double min = nums[0];
-  double max = nums[0];
-  double sum = nums[0];
-  for (int i = 1; i < len; i++) {
-    sum += nums.at(i);
-    if (min > nums.at(i)) {
-      min = nums.at(i);
-    }
-    if (max < nums.at(i)) {
-      max = nums.at(i);
-    }
-  }
-  double avg = sum / len;
+  double min = nums.min();
+  double max = nums.max();
+  double avg = nums.mean();
 
   cout << setprecision(2) << std::fixed;
   cout << "Max: " << max << endl;
@@ -79,7 +55,7 @@ void print_nums() {
   cout << "Average: " << avg << endl;
   cout << "Last five: ";
 
-  for ( int i = 0; i < len; i++) {
+  for (size_t i = 0; i < nums.size(); i++) {
     cout << nums.at(i) << " ";
   }
   cout << endl;
@@ -105,7 +81,6 @@ bool read_nums() {
     cin >> value;
   }
 
-  nums.at(len) = value;
-  len++;
+  nums.add(value);
   return true;
 }
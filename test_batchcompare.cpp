@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "./BatchCompare.hpp"
+#include "./catch.hpp"
+
+using std::string;
+using std::vector;
+namespace fs = std::filesystem;
+
+// A directory that is removed with everything in it when it goes out of
+// scope
+struct TempDir {
+  fs::path path;
+  TempDir() {
+    char name[] = "/tmp/test_batchcompare_XXXXXX";
+    path = mkdtemp(name);
+  }
+  ~TempDir() { fs::remove_all(path); }
+};
+
+// Writes a width x height image whose pixels are all value to file
+static void write_image(const fs::path& file, UINT width, UINT height,
+                        UCHAR value) {
+  BitMap bmp(width, height);
+  for (UINT y = 0; y < height; ++y) {
+    for (UINT x = 0; x < width; ++x) {
+      bmp.set_pixel(x, y, RGB(value, value, value));
+    }
+  }
+  bmp.write_file(file.string());
+  REQUIRE(BMP_OK == bmp.check_error());
+}
+
+TEST_CASE("pairs_in_directories", "[Test_BatchCompare]") {
+  TempDir temp;
+  fs::create_directory(temp.path / "a");
+  fs::create_directory(temp.path / "b");
+  write_image(temp.path / "a" / "2.bmp", 4, 4, 0);
+  write_image(temp.path / "a" / "1.bmp", 4, 4, 0);
+  write_image(temp.path / "b" / "1.bmp", 4, 4, 0);
+  write_image(temp.path / "b" / "3.bmp", 4, 4, 0);
+  std::ofstream(temp.path / "a" / "notes.txt") << "not an image\n";
+
+  // sorted by name, only files of the first directory, missing ones kept
+  vector<ImagePair> pairs;
+  string error;
+  REQUIRE(pairs_in_directories((temp.path / "a").string(),
+                               (temp.path / "b").string(), pairs, error));
+  REQUIRE(2 == pairs.size());
+  REQUIRE((temp.path / "a" / "1.bmp").string() == pairs[0].file1);
+  REQUIRE((temp.path / "b" / "1.bmp").string() == pairs[0].file2);
+  REQUIRE((temp.path / "a" / "2.bmp").string() == pairs[1].file1);
+  REQUIRE((temp.path / "b" / "2.bmp").string() == pairs[1].file2);
+
+  REQUIRE_FALSE(pairs_in_directories((temp.path / "none").string(),
+                                     (temp.path / "b").string(), pairs,
+                                     error));
+  REQUIRE_FALSE(error.empty());
+}
+
+TEST_CASE("pairs_in_manifest", "[Test_BatchCompare]") {
+  TempDir temp;
+  const fs::path manifest = temp.path / "pairs.txt";
+  std::ofstream(manifest) << "# golden images\n"
+                          << "x.bmp   y.bmp\n"
+                          << "\n"
+                          << "\t/abs/x.bmp z.bmp  \n";
+
+  vector<ImagePair> pairs;
+  string error;
+  REQUIRE(pairs_in_manifest(manifest.string(), pairs, error));
+  REQUIRE(2 == pairs.size());
+  REQUIRE((temp.path / "x.bmp").string() == pairs[0].file1);
+  REQUIRE((temp.path / "y.bmp").string() == pairs[0].file2);
+  REQUIRE("/abs/x.bmp" == pairs[1].file1);
+  REQUIRE((temp.path / "z.bmp").string() == pairs[1].file2);
+
+  // a line with one path, or three, is an error
+  for (const char* line : {"x.bmp\n", "x.bmp y.bmp z.bmp\n"}) {
+    std::ofstream(manifest) << line;
+    pairs.clear();
+    REQUIRE_FALSE(pairs_in_manifest(manifest.string(), pairs, error));
+    REQUIRE_FALSE(error.empty());
+  }
+  REQUIRE_FALSE(pairs_in_manifest((temp.path / "none").string(), pairs,
+                                  error));
+}
+
+TEST_CASE("compare_batch", "[Test_BatchCompare]") {
+  TempDir temp;
+  write_image(temp.path / "black.bmp", 8, 6, 0);
+  write_image(temp.path / "black2.bmp", 8, 6, 0);
+  write_image(temp.path / "grey.bmp", 8, 6, 10);
+  const string black = (temp.path / "black.bmp").string();
+  const string black2 = (temp.path / "black2.bmp").string();
+  const string grey = (temp.path / "grey.bmp").string();
+  const string missing = (temp.path / "missing.bmp").string();
+
+  vector<ImagePair> pairs;
+  for (int i = 0; i < 5; ++i) {
+    pairs.push_back(ImagePair{black, black2});
+    pairs.push_back(ImagePair{black, grey});
+    pairs.push_back(ImagePair{missing, black});
+  }
+
+  // every pair is reported once, in order, for a few prefetch depths
+  ThreadPool pool(2);
+  for (size_t prefetch : {1, 2, 8}) {
+    BatchSettings settings;
+    settings.prefetch = prefetch;
+    settings.measure = prefetch == 2;
+    size_t reported = 0;
+    compare_batch(pairs, pool, settings, [&](const PairResult& result) {
+      REQUIRE(&pairs[reported] == result.pair);
+      switch (reported % 3) {
+        case 0:
+          REQUIRE(result.error.empty());
+          REQUIRE(48 == result.totals.correct_pixels);
+          REQUIRE(0 == result.totals.incorrect_pixels);
+          break;
+        case 1:
+          REQUIRE(result.error.empty());
+          REQUIRE(8 == result.width1);
+          REQUIRE(6 == result.height2);
+          REQUIRE(48 == result.totals.incorrect_pixels);
+          REQUIRE(48 * 30 == result.totals.diff);
+          if (settings.measure) {
+            REQUIRE(10 == result.quality.max_error);
+            REQUIRE(100 == result.quality.mse);
+          }
+          break;
+        default:
+          REQUIRE(0 == result.error.rfind(missing, 0));
+          break;
+      }
+      reported++;
+    });
+    REQUIRE(pairs.size() == reported);
+  }
+
+  size_t reported = 0;
+  compare_batch({}, pool, BatchSettings(),
+                [&](const PairResult&) { reported++; });
+  REQUIRE(0 == reported);
+}
@@ -0,0 +1,139 @@
+#include "./BmpCompare.hpp"
+#include "./ThreadPool.hpp"
+#include "./catch.hpp"
+
+// Fills bmp with a pattern that depends only on the position
+static void fill(BitMap& bmp) {
+  for (UINT y = 0; y < bmp.height(); ++y) {
+    for (UINT x = 0; x < bmp.width(); ++x) {
+      bmp.set_pixel(x, y, RGB(x * 7 + y, x + y * 3, 200 - x));
+    }
+  }
+}
+
+TEST_CASE("compare_images", "[Test_BmpCompare]") {
+  ThreadPool pool(3);
+  BitMap bmp1(40, 30);
+  BitMap bmp2(40, 30);
+  fill(bmp1);
+  fill(bmp2);
+
+  CompareTotals same = compare_images(bmp1, bmp2, pool);
+  REQUIRE(0 == same.diff);
+  REQUIRE(1200 == same.correct_pixels);
+  REQUIRE(0 == same.incorrect_pixels);
+
+  bmp2.set_pixel(3, 4, RGB(0, 0, 0));
+  RGB old = bmp1.get_pixel(3, 4);
+  bmp2.set_pixel(39, 29, RGB(bmp1.get_pixel(39, 29).red ^ 1, 0, 0));
+  RGB corner = bmp1.get_pixel(39, 29);
+  CompareTotals changed = compare_images(bmp1, bmp2, pool);
+  REQUIRE(old.red + old.green + old.blue + 1 + corner.green + corner.blue ==
+          changed.diff);
+  REQUIRE(1198 == changed.correct_pixels);
+  REQUIRE(2 == changed.incorrect_pixels);
+
+  // pixels of bmp1 outside a smaller bmp2 are compared with black, and
+  // none of them is black
+  BitMap small(30, 20);
+  fill(small);
+  CompareTotals cropped = compare_images(bmp1, small, pool);
+  REQUIRE(600 == cropped.correct_pixels);
+  REQUIRE(600 == cropped.incorrect_pixels);
+}
+
+TEST_CASE("images_within_tolerance", "[Test_BmpCompare]") {
+  ThreadPool pool(3);
+  BitMap bmp1(50, 40);
+  BitMap bmp2(50, 40);
+  fill(bmp1);
+  fill(bmp2);
+
+  REQUIRE(images_identical(bmp1, bmp2, pool));
+  REQUIRE(images_within_tolerance(bmp1, bmp2, 0, pool));
+
+  // seven differing pixels spread over the image
+  for (UINT i = 0; i < 7; ++i) {
+    RGB pixel = bmp2.get_pixel(i * 7, i * 5);
+    bmp2.set_pixel(i * 7, i * 5, RGB(pixel.red, pixel.green ^ 4, pixel.blue));
+  }
+  REQUIRE_FALSE(images_identical(bmp1, bmp2, pool));
+  REQUIRE_FALSE(images_within_tolerance(bmp1, bmp2, 0, pool));
+  REQUIRE_FALSE(images_within_tolerance(bmp1, bmp2, 6, pool));
+  REQUIRE(images_within_tolerance(bmp1, bmp2, 7, pool));
+  REQUIRE(images_within_tolerance(bmp1, bmp2, 2000, pool));
+
+  // different sizes are never identical, even where they overlap
+  BitMap small(50, 39);
+  fill(small);
+  REQUIRE_FALSE(images_identical(bmp1, small, pool));
+  REQUIRE(images_identical(small, small, pool));
+}
+
+TEST_CASE("compare_images_diff", "[Test_BmpCompare]") {
+  ThreadPool pool(3);
+  BitMap bmp1(100, 80);
+  BitMap bmp2(100, 80);
+  fill(bmp1);
+  fill(bmp2);
+
+  // a 3x3 blob, a lone pixel three cells to its right, and two pixels in
+  // cells that only touch at a corner
+  auto change = [&](UINT x, UINT y) {
+    RGB p = bmp2.get_pixel(x, y);
+    bmp2.set_pixel(x, y, RGB(p.red ^ 2, p.green, p.blue));
+  };
+  for (UINT y = 5; y < 8; ++y) {
+    for (UINT x = 10; x < 13; ++x) {
+      change(x, y);
+    }
+  }
+  change(60, 6);
+  change(47, 47);
+  change(48, 48);
+
+  for (DiffStyle style : {DiffStyle::kAbsolute, DiffStyle::kMask}) {
+    BitMap image(100, 80);
+    DiffOutput diff;
+    diff.image = &image;
+    diff.style = style;
+    diff.gain = 10;
+    CompareTotals totals = compare_images(bmp1, bmp2, pool, &diff);
+    REQUIRE(12 == totals.incorrect_pixels);
+    REQUIRE(24 == totals.diff);
+
+    REQUIRE(3 == diff.boxes.size());
+    REQUIRE(10 == diff.boxes[0].x);
+    REQUIRE(5 == diff.boxes[0].y);
+    REQUIRE(3 == diff.boxes[0].width);
+    REQUIRE(3 == diff.boxes[0].height);
+    REQUIRE(9 == diff.boxes[0].pixels);
+    REQUIRE(60 == diff.boxes[1].x);
+    REQUIRE(6 == diff.boxes[1].y);
+    REQUIRE(1 == diff.boxes[1].width);
+    REQUIRE(1 == diff.boxes[1].pixels);
+    REQUIRE(47 == diff.boxes[2].x);
+    REQUIRE(47 == diff.boxes[2].y);
+    REQUIRE(2 == diff.boxes[2].width);
+    REQUIRE(2 == diff.boxes[2].height);
+    REQUIRE(2 == diff.boxes[2].pixels);
+
+    RGB changed = image.get_pixel(11, 6);
+    RGB same = image.get_pixel(30, 30);
+    if (style == DiffStyle::kAbsolute) {
+      REQUIRE(20 == changed.red);
+      REQUIRE(0 == changed.green);
+      REQUIRE(0 == same.red + same.green + same.blue);
+    } else {
+      REQUIRE(255 == changed.red);
+      REQUIRE(0 == changed.green);
+      REQUIRE(0 == same.red);
+      REQUIRE(0 < same.green);
+    }
+  }
+
+  // identical images have no box
+  DiffOutput diff;
+  compare_images(bmp1, bmp1, pool, &diff);
+  REQUIRE(diff.boxes.empty());
+}
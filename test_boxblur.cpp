@@ -0,0 +1,163 @@
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "./BoxBlur.hpp"
+#include "./catch.hpp"
+
+using std::string;
+using std::vector;
+namespace fs = std::filesystem;
+
+// Image sizes with single rows and columns, and block sizes up to larger
+// than any of them, so that windows are clipped on every side
+static const UINT kSizes[][2] = {{1, 1}, {1, 7}, {7, 1}, {5, 4}, {13, 9}};
+static const int kBlockSizes[] = {1, 2, 3, 20};
+
+// Returns the color of pixel (x, y) of the test images
+static RGB pattern(UINT x, UINT y) {
+  return RGB(x * 53 + y * 11, 255 - x * 7 - y * 29, (x * y * 17) ^ 0xA5);
+}
+
+// An image filled with pattern(), of 32 BPP or, loaded from a file written
+// for it, of 24 BPP
+struct TestImage {
+  fs::path file;
+  BitMap image;
+
+  TestImage(UINT width, UINT height, UINT bytes_per_pixel)
+      : file(write_file(width, height, bytes_per_pixel)), image(file) {}
+  ~TestImage() { fs::remove(file); }
+
+  static fs::path write_file(UINT width, UINT height, UINT bytes_per_pixel) {
+    fs::path file = fs::temp_directory_path() /
+                    ("test_boxblur_" + std::to_string(width) + "x" +
+                     std::to_string(height) + "_" +
+                     std::to_string(bytes_per_pixel) + ".bmp");
+    BMP* bmp;
+    REQUIRE(BMP_OK == BMP_CreateEx(width, height, bytes_per_pixel * 8, &bmp));
+    for (UINT y = 0; y < height; ++y) {
+      for (UINT x = 0; x < width; ++x) {
+        RGB color = pattern(x, y);
+        BMP_SetPixelRGB(bmp, x, y, color.red, color.green, color.blue);
+      }
+    }
+    REQUIRE(BMP_OK == BMP_WriteFileEx(bmp, file.c_str()));
+    BMP_Free(bmp);
+    return file;
+  }
+};
+
+// Returns whether every pixel of a and b has the same color
+static bool same_pixels(BitMap& a, BitMap& b) {
+  bool same = a.width() == b.width() && a.height() == b.height();
+  for (UINT y = 0; same && y < a.height(); ++y) {
+    for (UINT x = 0; x < a.width(); ++x) {
+      RGB pa = a.get_pixel(x, y);
+      RGB pb = b.get_pixel(x, y);
+      same = same && pa.red == pb.red && pa.green == pb.green &&
+             pa.blue == pb.blue;
+    }
+  }
+  return same;
+}
+
+// Calls check(image, expected, block_size) for every test image, depth and
+// block size, with expected blurred by the naive kernel
+template <typename Check>
+static void for_each_case(Check check) {
+  for (const auto& size : kSizes) {
+    for (UINT bytes_per_pixel : {3U, 4U}) {
+      TestImage input(size[0], size[1], bytes_per_pixel);
+      REQUIRE(BMP_OK == input.image.check_error());
+      REQUIRE(bytes_per_pixel == input.image.bytes_per_pixel());
+      for (int block_size : kBlockSizes) {
+        INFO(size[0] << "x" << size[1] << " at " << bytes_per_pixel * 8
+                     << " BPP, block size " << block_size);
+        BitMap expected(size[0], size[1]);
+        blur_rows_naive(input.image, expected, block_size, 0, size[1] - 1);
+        check(input.image, expected, block_size);
+      }
+    }
+  }
+}
+
+TEST_CASE("summed_area_matches_naive", "[Test_BoxBlur]") {
+  for_each_case([](BitMap& image, BitMap& expected, int block_size) {
+    BitMap blur(image.width(), image.height());
+    SummedAreaTable table(image);
+    // in two calls, as threads would split the rows
+    const UINT half = image.height() / 2;
+    if (half > 0) {
+      table.blur_rows(blur, block_size, 0, half - 1);
+    }
+    table.blur_rows(blur, block_size, half, image.height() - 1);
+    REQUIRE(same_pixels(expected, blur));
+  });
+}
+
+TEST_CASE("naive_blur_of_one_pixel", "[Test_BoxBlur]") {
+  // the window of a lone pixel is the pixel itself
+  TestImage input(1, 1, 3);
+  BitMap blur(1, 1);
+  blur_rows_naive(input.image, blur, 5, 0, 0);
+  REQUIRE(same_pixels(input.image, blur));
+}
+
+TEST_CASE("separable_matches_naive", "[Test_BoxBlur]") {
+  for_each_case([](BitMap& image, BitMap& expected, int block_size) {
+    const UINT width = image.width();
+    const UINT height = image.height();
+    // whole passes, and passes split in ranges as threads would run them
+    for (UINT parts : {1U, 3U}) {
+      BitMap blur(width, height);
+      SeparableBlur separable(width, height, block_size);
+      for (UINT part = 0; part < parts; ++part) {
+        UINT first = height * part / parts;
+        UINT last = height * (part + 1) / parts;
+        if (first < last) {
+          separable.horizontal_pass(image, first, last - 1);
+        }
+      }
+      for (UINT part = 0; part < parts; ++part) {
+        UINT first = width * part / parts;
+        UINT last = width * (part + 1) / parts;
+        if (first < last) {
+          separable.vertical_pass(blur, first, last - 1);
+        }
+      }
+      REQUIRE(same_pixels(expected, blur));
+    }
+  });
+}
+
+TEST_CASE("tiles_match_naive", "[Test_BoxBlur]") {
+  // tiles of one pixel, tiles that leave partial tiles at the right and
+  // bottom edges, and a single tile larger than the image
+  static const UINT kTileSizes[][2] = {
+      {1, 1}, {2, 3}, {4, 4}, {3, 1}, {64, 64}};
+  for_each_case([](BitMap& image, BitMap& expected, int block_size) {
+    const UINT width = image.width();
+    const UINT height = image.height();
+    vector<uint32_t> scratch;
+    for (const auto& tile_size : kTileSizes) {
+      vector<Tile> tiles =
+          make_tiles(width, height, tile_size[0], tile_size[1]);
+      // the tiles cover every pixel once
+      size_t pixels = 0;
+      for (const Tile& tile : tiles) {
+        REQUIRE(tile.x1 < width);
+        REQUIRE(tile.y1 < height);
+        pixels += static_cast<size_t>(tile.x1 - tile.x0 + 1) *
+                  (tile.y1 - tile.y0 + 1);
+      }
+      REQUIRE(static_cast<size_t>(width) * height == pixels);
+
+      BitMap blur(width, height);
+      for (const Tile& tile : tiles) {
+        blur_tile(image, blur, block_size, tile, scratch);
+      }
+      REQUIRE(same_pixels(expected, blur));
+    }
+  });
+}
@@ -0,0 +1,321 @@
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "./ConcurrentQueue.hpp"
+#include "./catch.hpp"
+
+using std::make_unique;
+using std::optional;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// A value that counts how many of it are alive, can only be moved, and
+// has no default constructor
+struct Tracked {
+  static inline int alive = 0;
+  int id;
+
+  explicit Tracked(int id) : id(id) { alive++; }
+  Tracked(Tracked&& other) noexcept : id(other.id) { alive++; }
+  Tracked& operator=(Tracked&& other) noexcept {
+    id = other.id;
+    return *this;
+  }
+  Tracked(const Tracked&) = delete;
+  Tracked& operator=(const Tracked&) = delete;
+  ~Tracked() { alive--; }
+};
+
+// A value whose constructor throws for negative ids
+struct Picky {
+  int id;
+  explicit Picky(int id) : id(id) {
+    if (id < 0) {
+      throw std::invalid_argument("negative id");
+    }
+  }
+};
+
+}  // namespace
+
+TEST_CASE("move_only", "[Test_ConcurrentQueue]") {
+  ConcurrentQueue<unique_ptr<string>> q;
+
+  // the pointers move through the queue, so the payloads never get copied
+  auto payload = make_unique<string>(1000, 'x');
+  const string* address = payload.get();
+  REQUIRE(q.add(std::move(payload)));
+  REQUIRE(q.emplace(new string("emplaced")));
+  REQUIRE(2 == q.length());
+
+  optional<unique_ptr<string>> out = q.try_remove();
+  REQUIRE(out.has_value());
+  REQUIRE(address == out.value().get());
+  out = q.wait_remove();
+  REQUIRE(out.has_value());
+  REQUIRE("emplaced" == *out.value());
+  REQUIRE_FALSE(q.try_remove().has_value());
+
+  // bulk removal moves into the output span
+  REQUIRE(q.emplace(new string("a")));
+  REQUIRE(q.emplace(new string("b")));
+  vector<unique_ptr<string>> batch(4);
+  REQUIRE(2 == q.wait_remove_bulk(batch, batch.size()));
+  REQUIRE("a" == *batch[0]);
+  REQUIRE("b" == *batch[1]);
+
+  q.close();
+  REQUIRE_FALSE(q.add(make_unique<string>("closed")));
+  REQUIRE_FALSE(q.wait_remove().has_value());
+}
+
+TEST_CASE("value_lifetimes", "[Test_ConcurrentQueue]") {
+  Tracked::alive = 0;
+  {
+    ConcurrentQueue<Tracked> q;
+    for (int i = 0; i < 300; ++i) {
+      REQUIRE(q.emplace(i));
+    }
+    REQUIRE(300 == Tracked::alive);
+
+    // removed values are destroyed with the optional that holds them
+    for (int i = 0; i < 100; ++i) {
+      optional<Tracked> out = q.wait_remove();
+      REQUIRE(i == out.value().id);
+    }
+    REQUIRE(200 == Tracked::alive);
+
+    // closing does not refuse values before the close, only after
+    q.close();
+    REQUIRE_FALSE(q.emplace(-1));
+    REQUIRE(200 == Tracked::alive);
+  }
+  // the destructor destroys the values left in the queue
+  REQUIRE(0 == Tracked::alive);
+}
+
+TEST_CASE("throwing_constructor", "[Test_ConcurrentQueue]") {
+  ConcurrentQueue<Picky> q;
+  REQUIRE(q.emplace(1));
+  REQUIRE_THROWS_AS(q.emplace(-1), std::invalid_argument);
+  REQUIRE(1 == q.length());
+
+  REQUIRE(q.add(Picky(2)));
+  REQUIRE(1 == q.try_remove().value().id);
+  REQUIRE(2 == q.try_remove().value().id);
+  REQUIRE_FALSE(q.try_remove().has_value());
+
+  // the queue keeps working after the failed add
+  REQUIRE(q.emplace(3));
+  REQUIRE(3 == q.wait_remove().value().id);
+}
+
+TEST_CASE("wait_remove_wakes", "[Test_ConcurrentQueue]") {
+  ConcurrentQueue<unique_ptr<int>> q;
+  optional<unique_ptr<int>> out;
+  std::thread reader([&] { out = q.wait_remove(); });
+  usleep(100000);
+  REQUIRE_FALSE(out.has_value());
+  REQUIRE(q.add(make_unique<int>(42)));
+  reader.join();
+  REQUIRE(out.has_value());
+  REQUIRE(42 == *out.value());
+}
+
+TEST_CASE("timed_wait_remove", "[Test_ConcurrentQueue]") {
+  using std::chrono::milliseconds;
+  using std::chrono::steady_clock;
+  ConcurrentQueue<int> q;
+
+  // an empty queue times out no earlier than asked
+  auto start = steady_clock::now();
+  REQUIRE_FALSE(q.wait_remove_for(milliseconds(50)).has_value());
+  REQUIRE(steady_clock::now() - start >= milliseconds(50));
+
+  start = steady_clock::now();
+  REQUIRE_FALSE(q.wait_remove_until(start + milliseconds(20)).has_value());
+  REQUIRE(steady_clock::now() - start >= milliseconds(20));
+
+  // a value that is already there, or arrives in time, is returned
+  REQUIRE(q.add(1));
+  REQUIRE(1 == q.wait_remove_for(milliseconds(0)).value());
+  std::thread writer([&] {
+    usleep(50000);
+    q.add(2);
+  });
+  REQUIRE(2 == q.wait_remove_for(std::chrono::seconds(10)).value());
+  writer.join();
+
+  // a deadline in the past returns right away
+  REQUIRE_FALSE(
+      q.wait_remove_until(steady_clock::now() - milliseconds(10)).has_value());
+}
+
+TEST_CASE("cancel_wait_remove", "[Test_ConcurrentQueue]") {
+  using std::chrono::milliseconds;
+  using std::chrono::steady_clock;
+  ConcurrentQueue<int> q;
+  std::stop_source source;
+
+  // stopping the token wakes a waiter long before its timeout, and the
+  // queue stays open for everyone else
+  optional<int> out = 0;
+  auto start = steady_clock::now();
+  std::thread reader([&] {
+    out = q.wait_remove_for(std::chrono::seconds(30), source.get_token());
+  });
+  usleep(50000);
+  source.request_stop();
+  reader.join();
+  REQUIRE_FALSE(out.has_value());
+  REQUIRE(steady_clock::now() - start < std::chrono::seconds(5));
+  REQUIRE(q.add(3));
+
+  // an already stopped token does not wait, but still returns values
+  REQUIRE(3 == q.wait_remove(source.get_token()).value());
+  REQUIRE_FALSE(q.wait_remove(source.get_token()).has_value());
+
+  // the untimed wait can be stopped too
+  std::stop_source second;
+  out = 0;
+  std::thread untimed([&] { out = q.wait_remove(second.get_token()); });
+  usleep(50000);
+  second.request_stop();
+  untimed.join();
+  REQUIRE_FALSE(out.has_value());
+}
+
+TEST_CASE("wakes_enough_waiters", "[Test_ConcurrentQueue]") {
+  // every value reaches one of many blocked consumers, whether added one
+  // at a time or in a batch, including consumers whose waits time out
+  ConcurrentQueue<int> q;
+  std::atomic<int> removed{0};
+  vector<std::thread> consumers;
+  for (int c = 0; c < 8; ++c) {
+    consumers.emplace_back([&, c] {
+      while (true) {
+        optional<int> val = c % 2 == 0
+                                ? q.wait_remove()
+                                : q.wait_remove_for(std::chrono::milliseconds(1));
+        if (val) {
+          removed++;
+        } else if (c % 2 == 0 || removed.load() == 20) {
+          return;
+        }
+      }
+    });
+  }
+  usleep(50000);
+  const int batch[] = {1, 2, 3, 4, 5};
+  for (int round = 0; round < 2; ++round) {
+    REQUIRE(5 == q.add_bulk(batch));
+    for (int i = 0; i < 5; ++i) {
+      REQUIRE(q.add(i));
+    }
+    usleep(50000);
+  }
+  for (int waited = 0; removed.load() < 20 && waited < 100; ++waited) {
+    usleep(10000);
+  }
+  REQUIRE(20 == removed.load());
+  q.close();
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+}
+
+TEST_CASE("bounded_blocking_add", "[Test_ConcurrentQueue]") {
+  ConcurrentQueue<int> q(2);
+  REQUIRE(2 == q.capacity());
+  REQUIRE(q.add(1));
+  REQUIRE(q.try_add(2));
+
+  // a full queue refuses try_add and blocks add until a value is removed
+  REQUIRE_FALSE(q.try_add(3));
+  REQUIRE(2 == q.length());
+  std::atomic<bool> added{false};
+  std::thread producer([&] { added = q.add(3); });
+  usleep(100000);
+  REQUIRE_FALSE(added.load());
+  REQUIRE(1 == q.try_remove().value());
+  producer.join();
+  REQUIRE(added.load());
+  REQUIRE(2 == q.length());
+
+  // a batch bigger than the room left goes in as values are removed
+  const int batch[] = {4, 5, 6, 7};
+  size_t bulk_added = 0;
+  std::thread bulk([&] { bulk_added = q.add_bulk(batch); });
+  vector<int> out;
+  while (out.size() < 6) {
+    out.push_back(q.wait_remove().value());
+  }
+  bulk.join();
+  REQUIRE(4 == bulk_added);
+  REQUIRE(vector<int>{2, 3, 4, 5, 6, 7} == out);
+  REQUIRE(0 == q.dropped());
+}
+
+TEST_CASE("bounded_close", "[Test_ConcurrentQueue]") {
+  // close wakes producers blocked on a full queue, and values added before
+  // close can still be removed
+  ConcurrentQueue<int> q(1);
+  REQUIRE(q.add(1));
+  std::atomic<int> refused{0};
+  vector<std::thread> producers;
+  for (int p = 0; p < 2; ++p) {
+    producers.emplace_back([&] {
+      if (!q.add(2)) {
+        refused++;
+      }
+    });
+  }
+  const int batch[] = {3, 4};
+  size_t bulk_added = 1;
+  producers.emplace_back([&] { bulk_added = q.add_bulk(batch); });
+  usleep(100000);
+  q.close();
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  REQUIRE(2 == refused.load());
+  REQUIRE(0 == bulk_added);
+  REQUIRE(1 == q.wait_remove().value());
+  REQUIRE_FALSE(q.wait_remove().has_value());
+}
+
+TEST_CASE("drop_oldest", "[Test_ConcurrentQueue]") {
+  Tracked::alive = 0;
+  {
+    ConcurrentQueue<Tracked> q(3, QueueFullPolicy::kDropOldest);
+    for (int i = 0; i < 10; ++i) {
+      REQUIRE(q.emplace(i));
+    }
+    REQUIRE(q.try_emplace(10));
+    // the dropped values are destroyed, and the newest ones are kept
+    REQUIRE(3 == q.length());
+    REQUIRE(3 == Tracked::alive);
+    REQUIRE(8 == q.dropped());
+    REQUIRE(8 == q.try_remove().value().id);
+
+    // a batch bigger than the capacity keeps its tail
+    const int ids[] = {20, 21, 22, 23, 24};
+    ConcurrentQueue<int> ints(3, QueueFullPolicy::kDropOldest);
+    REQUIRE(5 == ints.add_bulk(ids));
+    REQUIRE(2 == ints.dropped());
+    REQUIRE(22 == ints.try_remove().value());
+  }
+  REQUIRE(0 == Tracked::alive);
+}
@@ -13,6 +13,8 @@
 #include <pthread.h>
 #include <iostream>
 #include <optional>
+#include <span>
+#include <thread>
 
 #include "./DoubleQueue.hpp"
 #include "./catch.hpp"
@@ -301,6 +303,58 @@ TEST_CASE("close", "[Test_DoubleQueue]") {
   delete arg;
 }
 
+TEST_CASE("bulk", "[Test_DoubleQueue]") {
+  DoubleQueue q;
+  const double vals[] = {kOne, kZero, kNegative, kPi, kRs};
+  double out[4] = {};
+
+  // an empty batch adds nothing
+  REQUIRE(0 == q.add_bulk(std::span<const double>()));
+  REQUIRE(0 == q.length());
+
+  // values come out in order, at most max at a time
+  REQUIRE(5 == q.add_bulk(vals));
+  REQUIRE(q.add(kPi));
+  REQUIRE(6 == q.length());
+  REQUIRE(2 == q.wait_remove_bulk(out, 2));
+  REQUIRE(kOne == out[0]);
+  REQUIRE(kZero == out[1]);
+  REQUIRE(4 == q.length());
+
+  // the size of out caps the batch as well
+  REQUIRE(4 == q.wait_remove_bulk(out, 100));
+  REQUIRE(kNegative == out[0]);
+  REQUIRE(kPi == out[1]);
+  REQUIRE(kRs == out[2]);
+  REQUIRE(kPi == out[3]);
+  REQUIRE(0 == q.length());
+
+  // single removes see values added in bulk, and the other way around
+  REQUIRE(2 == q.add_bulk(std::span<const double>(vals, 2)));
+  REQUIRE(kOne == q.remove().value());
+  REQUIRE(q.add(kRs));
+  REQUIRE(2 == q.wait_remove_bulk(out, 4));
+  REQUIRE(kZero == out[0]);
+  REQUIRE(kRs == out[1]);
+
+  // a blocked bulk remove wakes up for a bulk add
+  size_t removed = 0;
+  std::thread reader([&] { removed = q.wait_remove_bulk(out, 4); });
+  sleep(1);
+  REQUIRE(0 == removed);
+  REQUIRE(3 == q.add_bulk(std::span<const double>(vals, 3)));
+  reader.join();
+  REQUIRE(removed >= 1);
+  REQUIRE(kOne == out[0]);
+
+  // once closed, adds fail and removes drain what is left, then return 0
+  REQUIRE(static_cast<int>(3 - removed) == q.length());
+  q.close();
+  REQUIRE(0 == q.add_bulk(vals));
+  REQUIRE(3 - removed == q.wait_remove_bulk(out, 4));
+  REQUIRE(0 == q.wait_remove_bulk(out, 4));
+}
+
 void* read_doubles(void* arg) {
   ThreadArg* args = static_cast<ThreadArg*>(arg);
   DoubleQueue* q = args->queue;
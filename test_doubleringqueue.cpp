@@ -0,0 +1,135 @@
+#include <unistd.h>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "./DoubleRingQueue.hpp"
+#include "./catch.hpp"
+
+using std::atomic;
+using std::optional;
+using std::thread;
+using std::vector;
+
+TEST_CASE("ring_add_remove", "[Test_DoubleRingQueue]") {
+  DoubleRingQueue q(3);
+  REQUIRE(4 == q.capacity());
+
+  // try removing before anything has happened
+  REQUIRE_FALSE(q.remove().has_value());
+
+  // fill the ring and wrap around it a few times
+  for (int lap = 0; lap < 3; ++lap) {
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(q.add(lap * 10 + i));
+    }
+    REQUIRE(4 == q.length());
+    for (int i = 0; i < 4; ++i) {
+      optional<double> opt = q.remove();
+      REQUIRE(opt.has_value());
+      REQUIRE(lap * 10 + i == opt.value());
+    }
+    REQUIRE(0 == q.length());
+    REQUIRE_FALSE(q.remove().has_value());
+  }
+}
+
+TEST_CASE("ring_blocking", "[Test_DoubleRingQueue]") {
+  DoubleRingQueue q(2);
+  atomic<int> stage{0};
+
+  // a full ring blocks add until a value is removed
+  REQUIRE(q.add(1.0));
+  REQUIRE(q.add(2.0));
+  thread producer([&] {
+    if (q.add(3.0)) {
+      stage = 1;
+    }
+  });
+  usleep(100000);
+  REQUIRE(0 == stage.load());
+  REQUIRE(1.0 == q.wait_remove().value());
+  producer.join();
+  REQUIRE(1 == stage.load());
+
+  // an empty ring blocks wait_remove until a value is added
+  REQUIRE(2.0 == q.wait_remove().value());
+  REQUIRE(3.0 == q.wait_remove().value());
+  optional<double> read;
+  thread consumer([&] {
+    read = q.wait_remove();
+    stage = 2;
+  });
+  usleep(100000);
+  REQUIRE(1 == stage.load());
+  REQUIRE(q.add(4.0));
+  consumer.join();
+  REQUIRE(read.has_value());
+  REQUIRE(4.0 == read.value());
+}
+
+TEST_CASE("ring_close", "[Test_DoubleRingQueue]") {
+  // close wakes a consumer waiting on an empty ring
+  DoubleRingQueue empty(4);
+  optional<double> read = 0.0;
+  thread consumer([&] { read = empty.wait_remove(); });
+  usleep(100000);
+  empty.close();
+  consumer.join();
+  REQUIRE_FALSE(read.has_value());
+
+  // close wakes a producer waiting on a full ring, and values added
+  // before close can still be removed
+  DoubleRingQueue full(2);
+  REQUIRE(full.add(1.0));
+  REQUIRE(full.add(2.0));
+  bool added = true;
+  thread producer([&] { added = full.add(3.0); });
+  usleep(100000);
+  full.close();
+  producer.join();
+  REQUIRE_FALSE(added);
+  REQUIRE_FALSE(full.add(4.0));
+  REQUIRE(1.0 == full.wait_remove().value());
+  REQUIRE(2.0 == full.remove().value());
+  REQUIRE_FALSE(full.wait_remove().has_value());
+  REQUIRE_FALSE(full.remove().has_value());
+}
+
+TEST_CASE("ring_many_threads", "[Test_DoubleRingQueue]") {
+  constexpr int kThreads = 4;
+  constexpr int kPerProducer = 50000;
+  DoubleRingQueue q(64);
+  vector<atomic<int>> seen(kThreads * kPerProducer);
+
+  vector<thread> producers;
+  for (int p = 0; p < kThreads; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kPerProducer; ++i) {
+        q.add(p * kPerProducer + i);
+      }
+    });
+  }
+  vector<thread> consumers;
+  for (int c = 0; c < kThreads; ++c) {
+    consumers.emplace_back([&] {
+      while (optional<double> val = q.wait_remove()) {
+        seen[static_cast<int>(val.value())]++;
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  q.close();
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+
+  // every value is removed exactly once
+  for (auto& count : seen) {
+    REQUIRE(1 == count.load());
+  }
+  REQUIRE(0 == q.length());
+}
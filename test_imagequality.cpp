@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+#include "./ImageQuality.hpp"
+#include "./catch.hpp"
+
+// Fills bmp with pixels from rng
+static void fill_random(BitMap& bmp, std::mt19937& rng) {
+  for (UINT y = 0; y < bmp.height(); ++y) {
+    for (UINT x = 0; x < bmp.width(); ++x) {
+      bmp.set_pixel(x, y, RGB(rng(), rng(), rng()));
+    }
+  }
+}
+
+// The luma measure_quality() uses
+static double luma_of(RGB p) {
+  return (77 * p.red + 150 * p.green + 29 * p.blue + 128) >> 8;
+}
+
+// SSIM computed window by window, straight from the definition
+static double naive_ssim(BitMap& bmp1, BitMap& bmp2, UINT window) {
+  const double c1 = 6.5025, c2 = 58.5225;
+  const double n = window * window;
+  double sum = 0;
+  UINT windows = 0;
+  for (UINT top = 0; top + window <= bmp1.height(); ++top) {
+    for (UINT left = 0; left + window <= bmp1.width(); ++left) {
+      double mx = 0, my = 0;
+      for (UINT y = top; y < top + window; ++y) {
+        for (UINT x = left; x < left + window; ++x) {
+          mx += luma_of(bmp1.get_pixel(x, y)) / n;
+          my += luma_of(bmp2.get_pixel(x, y)) / n;
+        }
+      }
+      double vx = 0, vy = 0, cov = 0;
+      for (UINT y = top; y < top + window; ++y) {
+        for (UINT x = left; x < left + window; ++x) {
+          double a = luma_of(bmp1.get_pixel(x, y)) - mx;
+          double b = luma_of(bmp2.get_pixel(x, y)) - my;
+          vx += a * a / n;
+          vy += b * b / n;
+          cov += a * b / n;
+        }
+      }
+      sum += ((2 * mx * my + c1) * (2 * cov + c2)) /
+             ((mx * mx + my * my + c1) * (vx + vy + c2));
+      windows++;
+    }
+  }
+  return sum / windows;
+}
+
+TEST_CASE("quality_identical", "[Test_ImageQuality]") {
+  ThreadPool pool(3);
+  std::mt19937 rng(7);
+  BitMap bmp1(37, 29);
+  BitMap bmp2(37, 29);
+  fill_random(bmp1, rng);
+  rng.seed(7);
+  fill_random(bmp2, rng);
+
+  QualityMetrics metrics = measure_quality(bmp1, bmp2, pool);
+  REQUIRE(0 == metrics.mse);
+  REQUIRE(std::isinf(metrics.psnr));
+  REQUIRE(0 == metrics.max_error);
+  REQUIRE(metrics.ssim == Catch::Approx(1.0));
+}
+
+TEST_CASE("quality_errors", "[Test_ImageQuality]") {
+  // one channel of one pixel off by 30, and another by 3
+  ThreadPool pool(2);
+  BitMap bmp1(20, 10);
+  BitMap bmp2(20, 10);
+  bmp2.set_pixel(4, 3, RGB(0, 30, 0));
+  bmp2.set_pixel(19, 9, RGB(0, 0, 3));
+
+  QualityMetrics metrics = measure_quality(bmp1, bmp2, pool);
+  const double mse = (30.0 * 30 + 3 * 3) / (3 * 200);
+  REQUIRE(metrics.mse == Catch::Approx(mse));
+  REQUIRE(metrics.psnr == Catch::Approx(10 * std::log10(255.0 * 255 / mse)));
+  REQUIRE(30 == metrics.max_error);
+  REQUIRE(metrics.ssim < 1.0);
+}
+
+TEST_CASE("quality_ssim_matches_definition", "[Test_ImageQuality]") {
+  // random images with some shared structure, for several windows and
+  // pool sizes, including windows larger than the image
+  std::mt19937 rng(11);
+  BitMap bmp1(41, 33);
+  BitMap bmp2(41, 33);
+  fill_random(bmp1, rng);
+  for (UINT y = 0; y < bmp1.height(); ++y) {
+    for (UINT x = 0; x < bmp1.width(); ++x) {
+      RGB p = bmp1.get_pixel(x, y);
+      int noise = static_cast<int>(rng() % 41) - 20;
+      UCHAR g = static_cast<UCHAR>(std::clamp(p.green + noise, 0, 255));
+      bmp2.set_pixel(x, y, RGB(p.red, g, p.blue));
+    }
+  }
+
+  for (unsigned threads : {1U, 4U}) {
+    ThreadPool pool(threads);
+    for (UINT window : {1, 3, 8, 11, 33}) {
+      QualityMetrics metrics = measure_quality(bmp1, bmp2, pool, window);
+      REQUIRE(metrics.ssim == Catch::Approx(naive_ssim(bmp1, bmp2, window)));
+    }
+    REQUIRE(measure_quality(bmp1, bmp2, pool, 100).ssim ==
+            Catch::Approx(naive_ssim(bmp1, bmp2, 33)));
+  }
+}
+
+TEST_CASE("quality_mismatched_sizes", "[Test_ImageQuality]") {
+  // only the shared top left pixels count
+  ThreadPool pool(2);
+  BitMap bmp1(10, 10);
+  BitMap bmp2(6, 12);
+  bmp1.set_pixel(8, 8, RGB(255, 255, 255));
+  bmp2.set_pixel(5, 11, RGB(255, 255, 255));
+  bmp2.set_pixel(5, 9, RGB(10, 0, 0));
+
+  QualityMetrics metrics = measure_quality(bmp1, bmp2, pool);
+  REQUIRE(10 == metrics.max_error);
+  REQUIRE(metrics.mse == Catch::Approx(100.0 / (3 * 60)));
+}
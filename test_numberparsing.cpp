@@ -0,0 +1,76 @@
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "./NumberParsing.hpp"
+#include "./catch.hpp"
+
+using std::optional;
+using std::string;
+
+// What stod makes of line: the number, or nullopt if it throws
+static optional<double> stodResult(const string& line) {
+  try {
+    return std::stod(line);
+  } catch (const std::logic_error&) {
+    return std::nullopt;
+  }
+}
+
+// Requires parseLine and stod to agree on line, down to the sign of zero
+static void requireSameAsStod(const string& line) {
+  INFO("line: \"" << line << "\"");
+  optional<double> expected = stodResult(line);
+  optional<double> parsed = parseLine(line.data(), line.data() + line.size());
+  REQUIRE(expected.has_value() == parsed.has_value());
+  if (expected) {
+    if (std::isnan(*expected)) {
+      REQUIRE(std::isnan(*parsed));
+    } else {
+      REQUIRE(*expected == *parsed);
+      REQUIRE(std::signbit(*expected) == std::signbit(*parsed));
+    }
+  }
+}
+
+TEST_CASE("parse_like_stod", "[Test_NumberParsing]") {
+  for (const char* line :
+       {"0", "-0", "+0", "42", "-3.25", "  \t7.5", "1e10", "2.5abc", ".5",
+        "5.", "1e", "inf", "-infinity", "nan", "", "   ", "abc", "--5",
+        "+-5", "- 5", "0x10", "-0x1p4", "0X1.8p1", "0x", "-0x", "0xg",
+        "00x5", "1e308", "1e309", "-1e309", "0x1p1024"}) {
+    requireSameAsStod(line);
+  }
+}
+
+TEST_CASE("parse_sign_after_hex_prefix", "[Test_NumberParsing]") {
+  // stod stops at the x and reads 0, whatever follows
+  for (const char* line : {"0x-5", "0x+5", "-0x-5", "+0x+1p3", "0x-"}) {
+    requireSameAsStod(line);
+  }
+}
+
+TEST_CASE("parse_underflow", "[Test_NumberParsing]") {
+  // stod rejects numbers too small for a normal double unless they are
+  // exactly a subnormal one, and accepts zeros with any exponent
+  for (const char* line :
+       {"1e-310", "4.9e-324", "1e-320", "-1e-320", "2.2250738585072011e-308",
+        "2.2250738585072014e-308", "1e-400", "-1e-400", "0e-400",
+        "0.000e-999", "0x1p-1074", "0x0.8p-1022", "0x1p-1075", "0x1p-1022",
+        "0x0p-2000", "1e-320 and text"}) {
+    requireSameAsStod(line);
+  }
+}
+
+TEST_CASE("parse_stops_at_line_end", "[Test_NumberParsing]") {
+  // the line is not terminated: whatever follows it in the buffer must
+  // not be read, even when the number is reparsed
+  const char buffer[] = "1e-320\n5\n   \n7";
+  REQUIRE_FALSE(parseLine(buffer, buffer + 6).has_value());
+  REQUIRE_FALSE(parseLine(buffer + 9, buffer + 12).has_value());
+  const char digits[] = "0.0000123";
+  optional<double> num = parseLine(digits, digits + 3);  // "0.0"
+  REQUIRE(num.has_value());
+  REQUIRE(0.0 == *num);
+}
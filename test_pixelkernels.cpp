@@ -0,0 +1,92 @@
+#include <string>
+#include <vector>
+
+#include "./PixelKernels.hpp"
+#include "./catch.hpp"
+
+using std::string;
+using std::vector;
+
+// Runs check() with every version of the kernels the CPU supports, and
+// then goes back to the version picked at startup
+template <typename Check>
+static void for_each_isa(Check check) {
+  for (const char* isa : {"avx2", "sse2", "scalar"}) {
+    if (string(select_pixel_kernels(isa)) == isa) {
+      INFO("isa: " << isa);
+      check();
+    }
+  }
+  select_pixel_kernels(nullptr);
+}
+
+TEST_CASE("invert_row", "[Test_PixelKernels]") {
+  // widths around every vector size, so each version's tail is covered
+  for_each_isa([] {
+    for (UINT bpp : {3U, 4U}) {
+      for (UINT width = 0; width <= 70; ++width) {
+        const UINT padding = 5;
+        vector<UCHAR> row(width * bpp + padding);
+        for (size_t i = 0; i < row.size(); ++i) {
+          row[i] = static_cast<UCHAR>(i * 37 + width);
+        }
+        vector<UCHAR> original = row;
+
+        invert_row(RowSpan{row.data(), width, bpp});
+
+        for (size_t i = 0; i < width * bpp; ++i) {
+          if (bpp == 4 && i % 4 == 3) {
+            REQUIRE(0 == row[i]);
+          } else {
+            REQUIRE(255 - original[i] == row[i]);
+          }
+        }
+        for (size_t i = width * bpp; i < row.size(); ++i) {
+          REQUIRE(original[i] == row[i]);
+        }
+      }
+    }
+  });
+}
+
+TEST_CASE("compare_rows", "[Test_PixelKernels]") {
+  // widths around every vector size, with about half of the pixels equal
+  // and alpha bytes that differ but must not count
+  for_each_isa([] {
+    for (UINT bpp1 : {3U, 4U}) {
+      for (UINT bpp2 : {3U, 4U}) {
+        for (UINT width = 0; width <= 100; ++width) {
+          vector<UCHAR> row1(width * bpp1 + 3);
+          vector<UCHAR> row2(width * bpp2 + 3);
+          uint64_t expected_diff = 0;
+          UINT expected_matching = 0;
+          for (UINT x = 0; x < width; ++x) {
+            bool same = (x * 7 + width) % 3 != 0;
+            int pixel_diff = 0;
+            for (UINT c = 0; c < 3; ++c) {
+              UCHAR v1 = static_cast<UCHAR>(x * 31 + c * 101 + width);
+              UCHAR v2 = same ? v1 : static_cast<UCHAR>(v1 * 13 + c + x % 2);
+              row1[x * bpp1 + c] = v1;
+              row2[x * bpp2 + c] = v2;
+              pixel_diff += v1 > v2 ? v1 - v2 : v2 - v1;
+            }
+            if (bpp1 == 4) {
+              row1[x * 4 + 3] = static_cast<UCHAR>(x);
+            }
+            if (bpp2 == 4) {
+              row2[x * 4 + 3] = static_cast<UCHAR>(255 - x);
+            }
+            expected_diff += pixel_diff;
+            expected_matching += pixel_diff == 0;
+          }
+
+          RowComparison result = compare_rows(RowSpan{row1.data(), width, bpp1},
+                                              RowSpan{row2.data(), width, bpp2},
+                                              width);
+          REQUIRE(expected_diff == result.diff);
+          REQUIRE(expected_matching == result.matching);
+        }
+      }
+    }
+  });
+}
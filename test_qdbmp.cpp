@@ -0,0 +1,293 @@
+#include <stdlib.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./qdbmp.hpp"
+#include "./catch.hpp"
+
+using std::string;
+using std::vector;
+namespace fs = std::filesystem;
+
+// A directory that is removed with everything in it when it goes out of
+// scope
+struct TempDir {
+  fs::path path;
+  TempDir() {
+    char name[] = "/tmp/test_qdbmp_XXXXXX";
+    path = mkdtemp(name);
+  }
+  ~TempDir() { fs::remove_all(path); }
+};
+
+// Returns the color of pixel (x, y) of the test images
+static RGB pattern(UINT x, UINT y) {
+  return RGB(x * 41 + y, 200 - y * 13, (x * 7) ^ (y * 3));
+}
+
+// Writes a width x height image of depth bits per pixel filled with
+// pattern() to file
+static void write_image(const fs::path& file,
+                        UINT width,
+                        UINT height,
+                        USHORT depth) {
+  BMP* bmp;
+  REQUIRE(BMP_OK == BMP_CreateEx(width, height, depth, &bmp));
+  for (UINT y = 0; y < height; ++y) {
+    for (UINT x = 0; x < width; ++x) {
+      RGB color = pattern(x, y);
+      BMP_SetPixelRGB(bmp, x, y, color.red, color.green, color.blue);
+    }
+  }
+  REQUIRE(BMP_OK == BMP_WriteFileEx(bmp, file.c_str()));
+  BMP_Free(bmp);
+}
+
+// Returns the bytes of file
+static vector<UCHAR> read_bytes(const fs::path& file) {
+  std::ifstream in(file, std::ios::binary);
+  return vector<UCHAR>(std::istreambuf_iterator<char>(in), {});
+}
+
+// Replaces the content of file with bytes
+static void write_bytes(const fs::path& file, const vector<UCHAR>& bytes) {
+  std::ofstream(file, std::ios::binary)
+      .write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+// Stores the little-endian 32 bit value at offset of a header
+static void put_uint32(vector<UCHAR>& bytes, size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    bytes[offset + i] = static_cast<UCHAR>(value >> (8 * i));
+  }
+}
+
+// Returns the little-endian value of size bytes at offset of a header
+static uint32_t get_uint(const vector<UCHAR>& bytes,
+                         size_t offset,
+                         int size) {
+  uint32_t value = 0;
+  for (int i = size - 1; i >= 0; --i) {
+    value = (value << 8) | bytes[offset + i];
+  }
+  return value;
+}
+
+// Returns whether every pixel of image has the color pattern() gives it
+static bool has_pattern(BitMap& image) {
+  bool same = true;
+  for (UINT y = 0; y < image.height(); ++y) {
+    for (UINT x = 0; x < image.width(); ++x) {
+      RGB pixel = image.get_pixel(x, y);
+      RGB expected = pattern(x, y);
+      same = same && pixel.red == expected.red &&
+             pixel.green == expected.green && pixel.blue == expected.blue;
+    }
+  }
+  return same;
+}
+
+TEST_CASE("bmp_last_error_per_thread", "[Test_Qdbmp]") {
+  TempDir temp;
+  const fs::path good = temp.path / "good.bmp";
+  const fs::path missing = temp.path / "missing.bmp";
+  write_image(good, 4, 3, 24);
+
+  REQUIRE(nullptr == BMP_ReadFile(missing.c_str()));
+  REQUIRE(BMP_FILE_NOT_FOUND == BMP_GetError());
+
+  // another thread starts with no error, and its errors stay its own
+  BMP_STATUS other_start = BMP_ERROR;
+  BMP_STATUS other_after = BMP_ERROR;
+  std::thread([&] {
+    other_start = BMP_GetError();
+    BMP_Free(BMP_ReadFile(good.c_str()));
+    other_after = BMP_GetError();
+  }).join();
+  REQUIRE(BMP_OK == other_start);
+  REQUIRE(BMP_OK == other_after);
+  REQUIRE(BMP_FILE_NOT_FOUND == BMP_GetError());
+
+  BMP* bmp = BMP_ReadFile(good.c_str());
+  REQUIRE(nullptr != bmp);
+  REQUIRE(BMP_OK == BMP_GetError());
+  BMP_Free(bmp);
+}
+
+TEST_CASE("bmp_status_returning_calls", "[Test_Qdbmp]") {
+  TempDir temp;
+  const fs::path good = temp.path / "good.bmp";
+  write_image(good, 4, 3, 32);
+  BMP* earlier = BMP_ReadFile(good.c_str());
+  REQUIRE(BMP_OK == BMP_GetError());
+
+  // the Ex calls report failures only through their result, and clear
+  // the image they were given
+  BMP* bmp = earlier;
+  REQUIRE(BMP_FILE_NOT_FOUND ==
+          BMP_ReadFileEx((temp.path / "missing.bmp").c_str(), &bmp));
+  REQUIRE(nullptr == bmp);
+  BMP_Free(earlier);
+  REQUIRE(BMP_FILE_NOT_FOUND ==
+          BMP_MapFileEx((temp.path / "missing.bmp").c_str(), &bmp));
+  REQUIRE(BMP_INVALID_ARGUMENT == BMP_CreateEx(0, 3, 24, &bmp));
+  REQUIRE(BMP_FILE_NOT_SUPPORTED == BMP_CreateEx(4, 3, 16, &bmp));
+  REQUIRE(BMP_INVALID_ARGUMENT == BMP_ReadFileEx(nullptr, &bmp));
+  REQUIRE(BMP_INVALID_ARGUMENT == BMP_ReadFileEx(good.c_str(), nullptr));
+  REQUIRE(BMP_OK == BMP_GetError());
+
+  REQUIRE(BMP_OK == BMP_ReadFileEx(good.c_str(), &bmp));
+  REQUIRE(BMP_FILE_NOT_FOUND ==
+          BMP_WriteFileEx(bmp, (temp.path / "no" / "such.bmp").c_str()));
+  BMP_Free(bmp);
+  REQUIRE(BMP_OK == BMP_GetError());
+
+  // BitMap keeps the status of its own last call
+  BitMap image((temp.path / "missing.bmp").string());
+  REQUIRE(BMP_FILE_NOT_FOUND == image.check_error());
+  REQUIRE(string("File not found") == image.error_description());
+}
+
+TEST_CASE("bmp_map_file", "[Test_Qdbmp]") {
+  // a mapped image has the same pixels as a read one, at every depth
+  TempDir temp;
+  for (USHORT depth : {24, 32}) {
+    const fs::path file = temp.path / ("image" + std::to_string(depth));
+    write_image(file, 13, 7, depth);
+    for (auto mode : {BitMap::LoadMode::kRead, BitMap::LoadMode::kMap}) {
+      BitMap image(file.string(), mode);
+      REQUIRE(BMP_OK == image.check_error());
+      REQUIRE(13 == image.width());
+      REQUIRE(7 == image.height());
+      REQUIRE(depth / 8 == image.bytes_per_pixel());
+      REQUIRE(has_pattern(image));
+    }
+  }
+
+  // pixels written to a mapped image change the copy in memory, never
+  // the file
+  const fs::path file = temp.path / "image32";
+  const vector<UCHAR> before = read_bytes(file);
+  {
+    BitMap image(file.string(), BitMap::LoadMode::kMap);
+    image.set_pixel(2, 3, RGB(1, 2, 3));
+    RGB pixel = image.get_pixel(2, 3);
+    REQUIRE(1 == pixel.red);
+    REQUIRE(3 == pixel.blue);
+  }
+  REQUIRE(before == read_bytes(file));
+}
+
+TEST_CASE("bmp_reject_broken_files", "[Test_Qdbmp]") {
+  TempDir temp;
+  const fs::path good = temp.path / "good.bmp";
+  const fs::path broken = temp.path / "broken.bmp";
+  write_image(good, 10, 6, 24);
+  const vector<UCHAR> bytes = read_bytes(good);
+
+  // Returns the status of loading broken in both modes, which must agree
+  auto load_status = [&] {
+    BitMap read(broken.string(), BitMap::LoadMode::kRead);
+    BitMap mapped(broken.string(), BitMap::LoadMode::kMap);
+    REQUIRE(read.check_error() == mapped.check_error());
+    return read.check_error();
+  };
+
+  // files cut inside the header or the pixels
+  for (size_t length : {size_t{0}, size_t{20}, size_t{54}, bytes.size() - 1}) {
+    INFO("cut to " << length << " bytes");
+    write_bytes(broken, vector<UCHAR>(bytes.begin(), bytes.begin() + length));
+    REQUIRE(BMP_FILE_INVALID == load_status());
+  }
+
+  // rows of 10 pixels of 3 bytes take 32 bytes; a header whose data size
+  // leaves fewer than 30 bytes per row would have pixels read past it
+  vector<UCHAR> short_rows = bytes;
+  put_uint32(short_rows, 34, 6 * 29);
+  write_bytes(broken, short_rows);
+  REQUIRE(BMP_FILE_INVALID == load_status());
+  put_uint32(short_rows, 34, 6 * 30);
+  write_bytes(broken, short_rows);
+  REQUIRE(BMP_OK == load_status());
+
+  // no rows at all
+  vector<UCHAR> no_rows = bytes;
+  put_uint32(no_rows, 22, 0);
+  write_bytes(broken, no_rows);
+  REQUIRE(BMP_FILE_INVALID == load_status());
+
+  // the intact file still loads, with its pixels
+  BitMap image(good.string(), BitMap::LoadMode::kMap);
+  REQUIRE(BMP_OK == image.check_error());
+  REQUIRE(has_pattern(image));
+}
+
+TEST_CASE("bmp_header_round_trip", "[Test_Qdbmp]") {
+  TempDir temp;
+  const fs::path file = temp.path / "image.bmp";
+  const fs::path copy = temp.path / "copy.bmp";
+
+  // every field of a new image sits at its offset in the packed header
+  write_image(file, 13, 5, 24);
+  vector<UCHAR> bytes = read_bytes(file);
+  const uint32_t data_size = 40 * 5;  // rows of 39 bytes padded to 40
+  REQUIRE(54 + data_size == bytes.size());
+  REQUIRE('B' == bytes[0]);
+  REQUIRE('M' == bytes[1]);
+  REQUIRE(bytes.size() == get_uint(bytes, 2, 4));
+  REQUIRE(0 == get_uint(bytes, 6, 4));  // reserved
+  REQUIRE(54 == get_uint(bytes, 10, 4));
+  REQUIRE(40 == get_uint(bytes, 14, 4));
+  REQUIRE(13 == get_uint(bytes, 18, 4));
+  REQUIRE(5 == get_uint(bytes, 22, 4));
+  REQUIRE(1 == get_uint(bytes, 26, 2));
+  REQUIRE(24 == get_uint(bytes, 28, 2));
+  REQUIRE(0 == get_uint(bytes, 30, 4));  // uncompressed
+  REQUIRE(data_size == get_uint(bytes, 34, 4));
+  for (size_t offset = 38; offset < 54; offset += 4) {
+    REQUIRE(0 == get_uint(bytes, offset, 4));
+  }
+
+  // every field decoded is encoded back at the same place, down to the
+  // ones no BitMap sets
+  put_uint32(bytes, 38, 2835);
+  put_uint32(bytes, 42, 3780);
+  put_uint32(bytes, 46, 7);
+  put_uint32(bytes, 50, 3);
+  bytes[6] = 0x12;
+  bytes[9] = 0x34;
+  write_bytes(file, bytes);
+  BMP* bmp;
+  REQUIRE(BMP_OK == BMP_ReadFileEx(file.c_str(), &bmp));
+  REQUIRE(BMP_OK == BMP_WriteFileEx(bmp, copy.c_str()));
+  BMP_Free(bmp);
+  REQUIRE(bytes == read_bytes(copy));
+
+  // the palette of an indexed image follows the header
+  REQUIRE(BMP_OK == BMP_CreateEx(3, 2, 8, &bmp));
+  BMP_SetPaletteColor(bmp, 1, 10, 20, 30);
+  BMP_SetPixelIndex(bmp, 2, 1, 1);
+  REQUIRE(BMP_OK == BMP_WriteFileEx(bmp, file.c_str()));
+  BMP_Free(bmp);
+  bytes = read_bytes(file);
+  REQUIRE(54 + 1024 == get_uint(bytes, 10, 4));
+  REQUIRE(8 == get_uint(bytes, 28, 2));
+  REQUIRE(bytes.size() == get_uint(bytes, 2, 4));
+  REQUIRE(BMP_OK == BMP_ReadFileEx(file.c_str(), &bmp));
+  REQUIRE(BMP_OK == BMP_WriteFileEx(bmp, copy.c_str()));
+  BMP_Free(bmp);
+  REQUIRE(bytes == read_bytes(copy));
+
+  // and BitMap expands it to the colors it indexes
+  BitMap image(file.string());
+  REQUIRE(BMP_OK == image.check_error());
+  RGB pixel = image.get_pixel(2, 1);
+  REQUIRE(10 == pixel.red);
+  REQUIRE(20 == pixel.green);
+  REQUIRE(30 == pixel.blue);
+}
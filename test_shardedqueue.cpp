@@ -0,0 +1,175 @@
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "./ShardedQueue.hpp"
+#include "./catch.hpp"
+
+using std::atomic;
+using std::optional;
+using std::thread;
+using std::vector;
+
+TEST_CASE("sharded_single_lane", "[Test_ShardedQueue]") {
+  // with one lane the queue is strictly FIFO
+  ShardedQueue<int> q(1);
+  REQUIRE(1 == q.lane_count());
+  REQUIRE_FALSE(q.try_remove().has_value());
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(q.add(i));
+  }
+  REQUIRE(10 == q.length());
+  for (int i = 0; i < 10; ++i) {
+    REQUIRE(i == q.try_remove().value());
+  }
+  REQUIRE(0 == q.length());
+  REQUIRE_FALSE(q.try_remove().has_value());
+}
+
+TEST_CASE("sharded_producer_order", "[Test_ShardedQueue]") {
+  // values of one producer keep their order, whichever lane it uses
+  constexpr int kProducers = 6;
+  constexpr int kPerProducer = 20000;
+  ShardedQueue<int> q(4);
+  vector<thread> producers;
+  for (int p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kPerProducer; ++i) {
+        q.add(p * kPerProducer + i);
+      }
+    });
+  }
+  vector<int> last(kProducers, -1);
+  bool ordered = true;
+  for (int n = 0; n < kProducers * kPerProducer; ++n) {
+    int val = q.wait_remove().value();
+    int p = val / kPerProducer;
+    ordered = ordered && val % kPerProducer == last[p] + 1;
+    last[p] = val % kPerProducer;
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  REQUIRE(ordered);
+  REQUIRE(0 == q.length());
+}
+
+TEST_CASE("sharded_lanes_per_queue", "[Test_ShardedQueue]") {
+  // the first two producers of a queue get its two lanes, whatever other
+  // queues threads in between used, so removes alternate between them
+  ShardedQueue<int> q(2);
+  ShardedQueue<int> other(2);
+  thread([&] {
+    for (int i = 0; i < 3; ++i) {
+      q.add(i);
+    }
+  }).join();
+  thread([&] {
+    other.add(0);
+    other.try_remove();
+  }).join();
+  thread([&] {
+    for (int i = 100; i < 103; ++i) {
+      q.add(i);
+    }
+  }).join();
+  REQUIRE(6 == q.length());
+  optional<int> prev = q.try_remove();
+  for (int n = 1; n < 6; ++n) {
+    optional<int> val = q.try_remove();
+    REQUIRE(val.has_value());
+    REQUIRE((*prev < 100) != (*val < 100));
+    prev = val;
+  }
+  REQUIRE(0 == q.length());
+}
+
+TEST_CASE("sharded_more_producers_than_slots", "[Test_ShardedQueue]") {
+  // producers past the ones a queue keeps track of still keep their order
+  constexpr int kProducers = 80;
+  ShardedQueue<int> q(3);
+  for (int p = 0; p < kProducers; ++p) {
+    thread([&, p] {
+      for (int i = 0; i < 3; ++i) {
+        q.add(p * 3 + i);
+      }
+    }).join();
+  }
+  REQUIRE(kProducers * 3 == q.length());
+  vector<int> last(kProducers, -1);
+  bool ordered = true;
+  while (optional<int> val = q.try_remove()) {
+    int p = *val / 3;
+    ordered = ordered && *val % 3 == last[p] + 1;
+    last[p] = *val % 3;
+  }
+  REQUIRE(ordered);
+  REQUIRE(std::count(last.begin(), last.end(), 2) == kProducers);
+}
+
+TEST_CASE("sharded_close", "[Test_ShardedQueue]") {
+  // close wakes consumers waiting on empty lanes, and values added before
+  // close can still be removed
+  ShardedQueue<int> q(3, LaneSelection::kPerCpu);
+  vector<optional<int>> reads(3, 0);
+  vector<thread> consumers;
+  for (int c = 0; c < 3; ++c) {
+    consumers.emplace_back([&, c] { reads[c] = q.wait_remove(); });
+  }
+  usleep(100000);
+  REQUIRE(q.add(7));
+  usleep(100000);
+  q.close();
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+  int got = 0;
+  for (auto& read : reads) {
+    if (read.has_value()) {
+      REQUIRE(7 == read.value());
+      got++;
+    }
+  }
+  REQUIRE(1 == got);
+  REQUIRE_FALSE(q.add(8));
+}
+
+TEST_CASE("sharded_many_threads", "[Test_ShardedQueue]") {
+  constexpr int kThreads = 4;
+  constexpr int kPerProducer = 50000;
+  ShardedQueue<int> q(kThreads);
+  vector<atomic<int>> seen(kThreads * kPerProducer);
+
+  vector<thread> producers;
+  for (int p = 0; p < kThreads; ++p) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kPerProducer; ++i) {
+        q.add(p * kPerProducer + i);
+      }
+    });
+  }
+  vector<thread> consumers;
+  for (int c = 0; c < kThreads; ++c) {
+    consumers.emplace_back([&] {
+      while (optional<int> val = q.wait_remove()) {
+        seen[val.value()]++;
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  q.close();
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+
+  // every value is removed exactly once
+  for (auto& count : seen) {
+    REQUIRE(1 == count.load());
+  }
+  REQUIRE(0 == q.length());
+}
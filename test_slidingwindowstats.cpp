@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include "./SlidingWindowStats.hpp"
+#include "./catch.hpp"
+
+using std::deque;
+
+TEST_CASE("window_matches_recomputing", "[Test_SlidingWindowStats]") {
+  // every statistic agrees with recomputing it over the window, for
+  // windows smaller and larger than the number of values added
+  std::mt19937 rng(595);
+  std::uniform_int_distribution<int> dist(-50, 50);
+  for (size_t window : {1, 2, 5, 64}) {
+    SlidingWindowStats stats(window);
+    REQUIRE(window == stats.window());
+    deque<double> expected;
+    bool same = true;
+    for (int i = 0; i < 2000; ++i) {
+      // few distinct values, so that ties for min and max are common
+      double val = dist(rng) / 4.0;
+      stats.add(val);
+      expected.push_back(val);
+      if (expected.size() > window) {
+        expected.pop_front();
+      }
+      same = same && stats.size() == expected.size();
+      same = same && stats.max() ==
+                         *std::max_element(expected.begin(), expected.end());
+      same = same && stats.min() ==
+                         *std::min_element(expected.begin(), expected.end());
+      // quarters add up exactly, so the sums must be equal
+      same = same && stats.sum() == std::accumulate(expected.begin(),
+                                                    expected.end(), 0.0);
+      for (size_t j = 0; j < expected.size(); ++j) {
+        same = same && stats.at(j) == expected[j];
+      }
+    }
+    REQUIRE(same);
+  }
+}
+
+TEST_CASE("window_ties_and_zeros", "[Test_SlidingWindowStats]") {
+  // the oldest of equal extremes is reported, like max_element
+  SlidingWindowStats stats(3);
+  stats.add(-0.0);
+  stats.add(0.0);
+  REQUIRE(std::signbit(stats.max()));
+  REQUIRE(std::signbit(stats.min()));
+  stats.add(1.0);
+  stats.add(1.0);
+  REQUIRE_FALSE(std::signbit(stats.min()));
+  REQUIRE(1.0 == stats.max());
+  REQUIRE(2.0 == stats.sum());
+  REQUIRE(2.0 / 3 == stats.mean());
+
+  stats.clear();
+  REQUIRE(0 == stats.size());
+  stats.add(7.0);
+  REQUIRE(7.0 == stats.min());
+  REQUIRE(7.0 == stats.mean());
+}
+
+TEST_CASE("window_compensated_sum", "[Test_SlidingWindowStats]") {
+  // a huge value passing through the window leaves no rounding error
+  // behind, and neither do many small ones
+  SlidingWindowStats stats(4);
+  stats.add(1e20);
+  for (int i = 0; i < 4; ++i) {
+    stats.add(0.1);
+  }
+  REQUIRE(0.1 + 0.1 + 0.1 + 0.1 == stats.sum());
+  for (int i = 0; i < 1000000; ++i) {
+    stats.add(0.1 * (i % 7));
+  }
+  double exact = 0.0;
+  for (size_t j = 0; j < stats.size(); ++j) {
+    exact += stats.at(j);
+  }
+  REQUIRE(std::fabs(stats.sum() - exact) < 1e-12);
+}
+
+TEST_CASE("window_non_finite", "[Test_SlidingWindowStats]") {
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  SlidingWindowStats stats(3);
+  stats.add(inf);
+  stats.add(1.0);
+  REQUIRE(inf == stats.max());
+  REQUIRE(inf == stats.mean());
+  stats.add(-inf);
+  REQUIRE(std::isnan(stats.sum()));
+  REQUIRE(-inf == stats.min());
+
+  // once the infinities have left, the mean is finite again
+  stats.add(2.0);
+  stats.add(4.0);
+  stats.add(6.0);
+  REQUIRE(4.0 == stats.mean());
+
+  // a NaN after the oldest value never is an extreme, but makes the sum
+  // NaN while it is there
+  stats.add(nan);
+  REQUIRE(6.0 == stats.max());
+  REQUIRE(4.0 == stats.min());
+  REQUIRE(std::isnan(stats.mean()));
+  stats.add(nan);
+  stats.add(nan);
+  REQUIRE(std::isnan(stats.max()));
+  REQUIRE(std::isnan(stats.min()));
+  stats.add(5.0);
+  stats.add(6.0);
+  stats.add(7.0);
+  REQUIRE(6.0 == stats.mean());
+}
+
+// Returns whether a and b are the same number, or both NaN of the same sign
+static bool sameOrSameNan(double a, double b) {
+  if (std::isnan(a) || std::isnan(b)) {
+    return std::isnan(a) && std::isnan(b) &&
+           std::signbit(a) == std::signbit(b);
+  }
+  return a == b;
+}
+
+TEST_CASE("window_nan_like_recomputing", "[Test_SlidingWindowStats]") {
+  // with NaN in the window, min and max are what min_element and
+  // max_element give: the oldest value if it is NaN, sign included. A sum
+  // with a single source of NaN, one NaN value or a pair of opposite
+  // infinities, is that NaN; which of several NaN an addition keeps is up
+  // to the compiler and hardware.
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> dist(-20, 20);
+  SlidingWindowStats stats(4);
+  deque<double> expected;
+  bool same = true;
+  for (int i = 0; i < 4000; ++i) {
+    int draw = dist(rng);
+    double val = draw == 20    ? nan
+                 : draw == -20 ? -nan
+                 : draw == 19  ? inf
+                 : draw == -19 ? -inf
+                               : draw / 2.0;
+    stats.add(val);
+    expected.push_back(val);
+    if (expected.size() > stats.window()) {
+      expected.pop_front();
+    }
+    same = same && sameOrSameNan(stats.max(), *std::max_element(
+                                                  expected.begin(),
+                                                  expected.end()));
+    same = same && sameOrSameNan(stats.min(), *std::min_element(
+                                                  expected.begin(),
+                                                  expected.end()));
+    long nanSources =
+        std::count_if(expected.begin(), expected.end(),
+                      [](double v) { return std::isnan(v); }) +
+        (std::count(expected.begin(), expected.end(), inf) > 0 &&
+         std::count(expected.begin(), expected.end(), -inf) > 0);
+    double sum = std::accumulate(expected.begin(), expected.end(), 0.0);
+    same = same && (nanSources > 1 ? std::isnan(stats.sum())
+                                   : sameOrSameNan(stats.sum(), sum));
+  }
+  REQUIRE(same);
+}
+
+TEST_CASE("window_overflowed_sum", "[Test_SlidingWindowStats]") {
+  // finite values whose sum overflows give an infinite sum, and the mean
+  // is finite again once they have left the window
+  SlidingWindowStats stats(3);
+  stats.add(1e308);
+  stats.add(1e308);
+  REQUIRE(std::numeric_limits<double>::infinity() == stats.sum());
+  stats.add(-std::numeric_limits<double>::infinity());
+  REQUIRE(std::isnan(stats.sum()));
+  stats.add(3.0);
+  REQUIRE(-std::numeric_limits<double>::infinity() == stats.sum());
+  stats.add(4.0);
+  stats.add(-1e308);
+  REQUIRE(std::isfinite(stats.mean()));
+  stats.add(-1e308);
+  REQUIRE(-std::numeric_limits<double>::infinity() == stats.sum());
+  stats.add(1.0);
+  stats.add(2.0);
+  stats.add(3.0);
+  REQUIRE(2.0 == stats.mean());
+
+  // clear() forgets an overflow too
+  stats.add(1e308);
+  stats.add(1e308);
+  stats.clear();
+  stats.add(4.0);
+  REQUIRE(4.0 == stats.mean());
+}
@@ -0,0 +1,180 @@
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "./SpscQueue.hpp"
+#include "./catch.hpp"
+
+using std::atomic;
+using std::make_unique;
+using std::optional;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+TEST_CASE("spsc_add_remove", "[Test_SpscQueue]") {
+  SpscQueue<int> q(3);
+  REQUIRE(4 == q.capacity());
+  REQUIRE_FALSE(q.try_remove().has_value());
+
+  // fill the ring and wrap around it a few times
+  for (int lap = 0; lap < 3; ++lap) {
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(q.add(lap * 10 + i));
+    }
+    REQUIRE_FALSE(q.try_add(99));
+    REQUIRE(4 == q.length());
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE(lap * 10 + i == q.try_remove().value());
+    }
+    REQUIRE(0 == q.length());
+    REQUIRE_FALSE(q.try_remove().has_value());
+  }
+
+  // bulk removal takes what is there, in order, up to max
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(q.try_add(i));
+  }
+  vector<int> out(8);
+  REQUIRE(2 == q.wait_remove_bulk(out, 2));
+  REQUIRE(0 == out[0]);
+  REQUIRE(1 == out[1]);
+  REQUIRE(1 == q.wait_remove_bulk(out, out.size()));
+  REQUIRE(2 == out[0]);
+}
+
+TEST_CASE("spsc_values", "[Test_SpscQueue]") {
+  // move-only values pass through, and values left in the queue are
+  // destroyed with it
+  auto shared = std::make_shared<int>(5);
+  {
+    SpscQueue<unique_ptr<int>> q(4);
+    REQUIRE(q.add(make_unique<int>(1)));
+    REQUIRE(q.emplace(new int(2)));
+    REQUIRE(1 == *q.try_remove().value());
+    REQUIRE(2 == *q.wait_remove().value());
+
+    SpscQueue<std::shared_ptr<int>> left(4);
+    REQUIRE(left.add(shared));
+    REQUIRE(left.add(shared));
+    REQUIRE(3 == shared.use_count());
+  }
+  REQUIRE(1 == shared.use_count());
+}
+
+TEST_CASE("spsc_blocking", "[Test_SpscQueue]") {
+  SpscQueue<int> q(2);
+  atomic<int> stage{0};
+
+  // a full ring blocks add until a value is removed
+  REQUIRE(q.add(1));
+  REQUIRE(q.add(2));
+  thread producer([&] {
+    if (q.add(3)) {
+      stage = 1;
+    }
+  });
+  usleep(100000);
+  REQUIRE(0 == stage.load());
+  REQUIRE(1 == q.wait_remove().value());
+  producer.join();
+  REQUIRE(1 == stage.load());
+
+  // an empty ring blocks wait_remove until a value is added
+  REQUIRE(2 == q.wait_remove().value());
+  REQUIRE(3 == q.wait_remove().value());
+  optional<int> read;
+  thread consumer([&] {
+    read = q.wait_remove();
+    stage = 2;
+  });
+  usleep(100000);
+  REQUIRE(1 == stage.load());
+  REQUIRE(q.add(4));
+  consumer.join();
+  REQUIRE(4 == read.value());
+}
+
+TEST_CASE("spsc_close", "[Test_SpscQueue]") {
+  // close wakes a consumer waiting on an empty ring
+  SpscQueue<int> empty(4);
+  optional<int> read = 0;
+  thread consumer([&] { read = empty.wait_remove(); });
+  usleep(100000);
+  empty.close();
+  consumer.join();
+  REQUIRE_FALSE(read.has_value());
+
+  // close wakes a producer waiting on a full ring, and values added
+  // before close can still be removed
+  SpscQueue<int> full(2);
+  REQUIRE(full.add(1));
+  REQUIRE(full.add(2));
+  bool added = true;
+  thread producer([&] { added = full.add(3); });
+  usleep(100000);
+  full.close();
+  producer.join();
+  REQUIRE_FALSE(added);
+  REQUIRE_FALSE(full.try_add(4));
+  REQUIRE(1 == full.wait_remove().value());
+  int out[4];
+  REQUIRE(1 == full.wait_remove_bulk(out, 4));
+  REQUIRE(2 == out[0]);
+  REQUIRE(0 == full.wait_remove_bulk(out, 4));
+  REQUIRE_FALSE(full.wait_remove().has_value());
+}
+
+TEST_CASE("spsc_stream", "[Test_SpscQueue]") {
+  // a long stream through a small ring arrives complete and in order
+  constexpr int kValues = 500000;
+  SpscQueue<int> q(16);
+  thread producer([&] {
+    for (int i = 0; i < kValues; ++i) {
+      q.add(i);
+    }
+    q.close();
+  });
+  int expected = 0;
+  bool ordered = true;
+  int batch[7];
+  while (size_t count = q.wait_remove_bulk(batch, 7)) {
+    for (size_t i = 0; i < count; ++i) {
+      ordered = ordered && batch[i] == expected++;
+    }
+  }
+  producer.join();
+  REQUIRE(ordered);
+  REQUIRE(kValues == expected);
+}
+
+TEST_CASE("spsc_add_bulk", "[Test_SpscQueue]") {
+  // a batch bigger than the ring goes in as values are removed
+  SpscQueue<int> q(4);
+  vector<int> vals(50);
+  for (int i = 0; i < 50; ++i) {
+    vals[i] = i;
+  }
+  size_t added = 0;
+  thread producer([&] { added = q.add_bulk(vals); });
+  vector<int> out;
+  while (out.size() < vals.size()) {
+    out.push_back(q.wait_remove().value());
+  }
+  producer.join();
+  REQUIRE(50 == added);
+  REQUIRE(vals == out);
+
+  // closing stops a batch part way
+  REQUIRE(2 == q.add_bulk(std::span<const int>(vals.data(), 2)));
+  thread blocked([&] { added = q.add_bulk(vals); });
+  usleep(100000);
+  q.close();
+  blocked.join();
+  REQUIRE(2 == added);
+  REQUIRE(4 == q.length());
+  REQUIRE(0 == q.add_bulk(vals));
+}
@@ -0,0 +1,118 @@
+#include <unistd.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "./ThreadPool.hpp"
+#include "./catch.hpp"
+
+using std::atomic;
+using std::vector;
+
+TEST_CASE("parallel_for_covers_range", "[Test_ThreadPool]") {
+  ThreadPool pool(4);
+  REQUIRE(4 == pool.size());
+
+  // every item is visited exactly once, for several grain sizes
+  for (size_t grain : {0, 1, 3, 64, 5000}) {
+    vector<atomic<int>> visits(1000);
+    pool.parallel_for(0, visits.size(), grain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        visits[i]++;
+      }
+    });
+    for (auto& count : visits) {
+      REQUIRE(1 == count.load());
+    }
+  }
+
+  // an offset range and an empty range
+  atomic<size_t> sum{0};
+  pool.parallel_for(10, 20, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      sum += i;
+    }
+  });
+  REQUIRE(145 == sum.load());
+  pool.parallel_for(5, 5, 1, [&](size_t, size_t) { sum = 0; });
+  REQUIRE(145 == sum.load());
+}
+
+TEST_CASE("parallel_for_steals", "[Test_ThreadPool]") {
+  ThreadPool pool(4);
+  vector<int> ran_on(64, -1);
+
+  // chunks of the first worker's share are slow, so the other workers
+  // should run some of them once their own shares are done
+  pool.parallel_for(0, ran_on.size(), 1, [&](size_t begin, size_t) {
+    ran_on[begin] = ThreadPool::current_worker();
+    if (begin < 16) {
+      usleep(10000);
+    }
+  });
+  int stolen = 0;
+  for (size_t i = 0; i < 16; ++i) {
+    REQUIRE(ran_on[i] >= 0);
+    stolen += ran_on[i] != ran_on[0];
+  }
+  REQUIRE(stolen > 0);
+  REQUIRE(-1 == ThreadPool::current_worker());
+}
+
+TEST_CASE("parallel_for_exception", "[Test_ThreadPool]") {
+  ThreadPool pool(3);
+  atomic<int> chunks{0};
+  REQUIRE_THROWS_AS(pool.parallel_for(0, 30, 1,
+                                      [&](size_t begin, size_t) {
+                                        chunks++;
+                                        if (begin == 7) {
+                                          throw std::runtime_error("chunk 7");
+                                        }
+                                      }),
+                    std::runtime_error);
+  REQUIRE(30 == chunks.load());
+
+  // the pool is still usable after a failed loop
+  chunks = 0;
+  pool.parallel_for(0, 30, 1, [&](size_t, size_t) { chunks++; });
+  REQUIRE(30 == chunks.load());
+}
+
+TEST_CASE("parallel_for_nested", "[Test_ThreadPool]") {
+  // a worker calling parallel_for on its own pool runs the inner loop
+  // itself, instead of waiting for workers that wait for it
+  ThreadPool pool(3);
+  vector<atomic<int>> visits(20 * 50);
+  atomic<bool> same_worker{true};
+  pool.parallel_for(0, 20, 1, [&](size_t begin, size_t end) {
+    const int outer = ThreadPool::current_worker();
+    for (size_t row = begin; row < end; ++row) {
+      pool.parallel_for(0, 50, 7, [&](size_t col_begin, size_t col_end) {
+        if (ThreadPool::current_worker() != outer) {
+          same_worker = false;
+        }
+        for (size_t col = col_begin; col < col_end; ++col) {
+          visits[row * 50 + col]++;
+        }
+      });
+    }
+  });
+  bool once = true;
+  for (auto& visit : visits) {
+    once = once && visit.load() == 1;
+  }
+  REQUIRE(once);
+  REQUIRE(same_worker.load());
+
+  // an exception in a nested loop reaches the outer caller
+  REQUIRE_THROWS_AS(pool.parallel_for(0, 3, 1,
+                                      [&](size_t, size_t) {
+                                        pool.parallel_for(
+                                            0, 4, 1, [](size_t begin, size_t) {
+                                              if (begin == 2) {
+                                                throw std::runtime_error("2");
+                                              }
+                                            });
+                                      }),
+                    std::runtime_error);
+}